@@ -71,10 +71,10 @@ bool ABuilding::CanBePlaced() const
     return bIsPlacementValid;
 }
 
-void ABuilding::UpdatePlacementValidation(const FVector& Location)
+void ABuilding::UpdatePlacementValidation(const FVector& Location, bool bFootprintAvailable)
 {
     EBuildingPlacementState PlacementState = ValidatePlacement(Location);
-    bIsPlacementValid = (PlacementState == EBuildingPlacementState::Valid);
+    bIsPlacementValid = bFootprintAvailable && (PlacementState == EBuildingPlacementState::Valid);
 
     // Update visual feedback
     if (BuildingMesh)
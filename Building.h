@@ -48,7 +48,8 @@ public:
     void SetPreviewMode(bool bEnable);
     void OnPlaced();
     bool CanBePlaced() const;
-    void UpdatePlacementValidation(const FVector& Location);
+    // bFootprintAvailable lets the caller veto placement when the cells under the building are taken
+    void UpdatePlacementValidation(const FVector& Location, bool bFootprintAvailable = true);
     EBuildingPlacementState ValidatePlacement(const FVector& Location) const;
 
 protected:
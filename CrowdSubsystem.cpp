@@ -0,0 +1,658 @@
+#include "CrowdSubsystem.h"
+#include "Unit.h"
+#include "OrcaSolver.h"
+#include "FlowFieldSubsystem.h"
+#include "UnitEventLog.h"
+#include "Async/ParallelFor.h"
+#include "Camera/PlayerCameraManager.h"
+#include "ConvexVolume.h"
+#include "Engine/GameViewportClient.h"
+#include "Engine/LocalPlayer.h"
+#include "GameFramework/PlayerController.h"
+#include "SceneView.h"
+
+static void LogTickBuckets(UWorld* World)
+{
+    if (const UCrowdSubsystem* Crowd = World ? World->GetSubsystem<UCrowdSubsystem>() : nullptr)
+    {
+        UE_LOG(LogTemp, Display, TEXT("Crowd: %d units, %d dormant, %d full rate, %d reduced rate, %d simulated last step"),
+            Crowd->GetNumUnits(),
+            Crowd->GetNumUnitsInBucket(ECrowdTickBucket::Dormant),
+            Crowd->GetNumUnitsInBucket(ECrowdTickBucket::Full),
+            Crowd->GetNumUnitsInBucket(ECrowdTickBucket::Reduced),
+            Crowd->GetNumUnitsSimulated());
+    }
+}
+
+static FAutoConsoleCommandWithWorld LogTickBucketsCommand(
+    TEXT("Crowd.TickBuckets"),
+    TEXT("Log how many units are parked, simulated every step and simulated at a reduced rate"),
+    FConsoleCommandWithWorldDelegate::CreateStatic(&LogTickBuckets));
+
+UCrowdSubsystem::UCrowdSubsystem()
+{
+    HashCellSize = 200.0f;
+    bSweepUnitMoves = true;
+    OrcaTimeHorizon = 1.0f;
+    MaxOrcaNeighbors = 10;
+    FinalApproachDistance = 300.0f;
+    ReducedRateDistance = 5000.0f;
+    ReducedRateInterval = 4;
+    FMemory::Memzero(BucketCounts);
+    bHashDirty = false;
+    NumPendingRemovals = 0;
+    StepCount = 0;
+}
+
+void UCrowdSubsystem::Deinitialize()
+{
+    UFlowFieldSubsystem* FlowFieldSubsystem = GetWorld()->GetSubsystem<UFlowFieldSubsystem>();
+    for (const FMoveGroup& Group : MoveGroups)
+    {
+        if (FlowFieldSubsystem && Group.RequestId != 0)
+        {
+            FlowFieldSubsystem->CancelFlowFieldRequest(Group.RequestId);
+        }
+    }
+    MoveGroups.Empty();
+
+    for (AUnit* Unit : Units)
+    {
+        if (Unit)
+        {
+            Unit->CrowdIndex = INDEX_NONE;
+        }
+    }
+
+    Units.Reset();
+    Positions.Reset();
+    Velocities.Reset();
+    Targets.Reset();
+    Yaws.Reset();
+    StuckTimes.Reset();
+    Flags.Reset();
+    Settings.Reset();
+    GroupIds.Reset();
+    PendingTimes.Reset();
+    PreviousPositions.Reset();
+    TickBuckets.Reset();
+    ActiveUnits.Reset();
+    SteeredUnits.Reset();
+    FMemory::Memzero(BucketCounts);
+    StartVelocities.Reset();
+    StartFlags.Reset();
+    JitterSeeds.Reset();
+    NumPendingRemovals = 0;
+    SpatialHash = FUnitSpatialHash();
+    Super::Deinitialize();
+}
+
+void UCrowdSubsystem::Tick(float DeltaTime)
+{
+    Super::Tick(DeltaTime);
+
+    ++StepCount;
+    RemovePendingUnits();
+    GatherActiveUnits(DeltaTime);
+
+    if (bHashDirty)
+    {
+        SpatialHash.Rebuild(Positions, HashCellSize);
+        bHashDirty = false;
+    }
+
+    UpdateSteering();
+    IntegrateAndWriteBack();
+}
+
+TStatId UCrowdSubsystem::GetStatId() const
+{
+    RETURN_QUICK_DECLARE_CYCLE_STAT(UCrowdSubsystem, STATGROUP_Tickables);
+}
+
+void UCrowdSubsystem::RegisterUnit(AUnit* Unit)
+{
+    if (!Unit || Unit->CrowdIndex != INDEX_NONE)
+        return;
+
+    Unit->CrowdIndex = Units.Add(Unit);
+    Positions.Add(Unit->GetActorLocation());
+    Velocities.Add(FVector::ZeroVector);
+    Targets.Add(Unit->GetActorLocation());
+    Yaws.Add(Unit->GetActorRotation().Yaw);
+    StuckTimes.Add(0.0f);
+    Flags.Add(0);
+
+    FUnitSettings& UnitSettings = Settings.AddDefaulted_GetRef();
+    UnitSettings.MaxSpeed = Unit->MovementSpeed;
+    UnitSettings.Acceleration = Unit->MovementSpeed * 2.0f;
+    UnitSettings.RotationSpeed = Unit->RotationSpeed;
+    UnitSettings.AcceptanceRadius = Unit->AcceptanceRadius;
+    UnitSettings.AvoidanceRadius = Unit->AvoidanceRadius;
+    UnitSettings.CollisionRadius = Unit->GetSimpleCollisionRadius();
+    UnitSettings.AvoidanceMode = Unit->AvoidanceMode;
+    UnitSettings.MovementMode = Unit->MovementMode;
+
+    JitterSeeds.Add(GetTypeHash(Unit->GetUniqueID()));
+    GroupIds.Add(INDEX_NONE);
+    PendingTimes.Add(0.0f);
+    PreviousPositions.Add(Unit->GetActorLocation());
+    TickBuckets.Add(ECrowdTickBucket::Dormant);
+    bHashDirty = true;
+}
+
+void UCrowdSubsystem::UnregisterUnit(AUnit* Unit)
+{
+    if (!IsValidSlot(Unit))
+        return;
+
+    const int32 Index = Unit->CrowdIndex;
+    LeaveMoveGroup(Index);
+    Units[Index] = nullptr;
+    Flags[Index] = UnitFlag_PendingRemoval;
+    Unit->CrowdIndex = INDEX_NONE;
+    ++NumPendingRemovals;
+}
+
+void UCrowdSubsystem::RemovePendingUnits()
+{
+    if (NumPendingRemovals == 0)
+        return;
+
+    for (int32 Index = Units.Num() - 1; Index >= 0; --Index)
+    {
+        if (!(Flags[Index] & UnitFlag_PendingRemoval))
+            continue;
+
+        // Swap the last slot into the hole, so the arrays stay packed and only the moved unit's index changes
+        Units.RemoveAtSwap(Index, 1, false);
+        Positions.RemoveAtSwap(Index, 1, false);
+        Velocities.RemoveAtSwap(Index, 1, false);
+        Targets.RemoveAtSwap(Index, 1, false);
+        Yaws.RemoveAtSwap(Index, 1, false);
+        StuckTimes.RemoveAtSwap(Index, 1, false);
+        Flags.RemoveAtSwap(Index, 1, false);
+        Settings.RemoveAtSwap(Index, 1, false);
+        JitterSeeds.RemoveAtSwap(Index, 1, false);
+        GroupIds.RemoveAtSwap(Index, 1, false);
+        PendingTimes.RemoveAtSwap(Index, 1, false);
+        PreviousPositions.RemoveAtSwap(Index, 1, false);
+        TickBuckets.RemoveAtSwap(Index, 1, false);
+
+        if (Units.IsValidIndex(Index))
+        {
+            Units[Index]->CrowdIndex = Index;
+        }
+    }
+    NumPendingRemovals = 0;
+    bHashDirty = true;
+}
+
+void UCrowdSubsystem::GatherActiveUnits(float DeltaTime)
+{
+    ActiveUnits.Reset();
+    SteeredUnits.Reset();
+    FMemory::Memzero(BucketCounts);
+
+    FVector CameraLocation = FVector::ZeroVector;
+    const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+    const bool bHasCamera = PlayerController && PlayerController->PlayerCameraManager;
+    if (bHasCamera)
+    {
+        CameraLocation = PlayerController->PlayerCameraManager->GetCameraLocation();
+    }
+
+    // Instanced units hide their own mesh, so whether they're on screen comes from the view rather than the actor
+    FConvexVolume ViewFrustum;
+    bool bHasFrustum = false;
+    const ULocalPlayer* LocalPlayer = bHasCamera ? PlayerController->GetLocalPlayer() : nullptr;
+    if (LocalPlayer && LocalPlayer->ViewportClient && LocalPlayer->ViewportClient->Viewport)
+    {
+        FSceneViewProjectionData ProjectionData;
+        if (LocalPlayer->GetProjectionData(LocalPlayer->ViewportClient->Viewport, ProjectionData))
+        {
+            GetViewFrustumBounds(ViewFrustum, ProjectionData.ComputeViewProjectionMatrix(), false);
+            bHasFrustum = true;
+        }
+    }
+
+    // Parked units only cost this check
+    for (int32 Index = 0; Index < Units.Num(); ++Index)
+    {
+        if (!(Flags[Index] & UnitFlag_Moving))
+        {
+            ++BucketCounts[static_cast<int32>(ECrowdTickBucket::Dormant)];
+            continue;
+        }
+
+        // Without a camera there's nothing to judge distance by, so everything runs at full rate
+        const bool bReduced = bHasCamera && ReducedRateInterval > 1
+            && (FVector::DistSquared(Positions[Index], CameraLocation) > FMath::Square(ReducedRateDistance)
+                || (bHasFrustum && !ViewFrustum.IntersectSphere(Positions[Index], Settings[Index].CollisionRadius)));
+
+        TickBuckets[Index] = bReduced ? ECrowdTickBucket::Reduced : ECrowdTickBucket::Full;
+        ++BucketCounts[static_cast<int32>(TickBuckets[Index])];
+
+        PendingTimes[Index] += DeltaTime;
+        ActiveUnits.Add(Index);
+        if (!bReduced || GetReducedRatePhase(Index) == 0)
+        {
+            SteeredUnits.Add(Index);
+        }
+    }
+}
+
+int32 UCrowdSubsystem::GetReducedRatePhase(int32 Index) const
+{
+    // Offset by the unit's seed so a group that slowed down together doesn't update together
+    return int32((StepCount + JitterSeeds[Index]) % uint32(FMath::Max(ReducedRateInterval, 1)));
+}
+
+void UCrowdSubsystem::UpdateSteering()
+{
+    // Small batches would spend more on scheduling than on steering
+    constexpr int32 MinUnitsPerBatch = 64;
+
+    if (SteeredUnits.Num() == 0)
+        return;
+
+    StartVelocities = Velocities;
+    StartFlags = Flags;
+
+    ParallelFor(TEXT("CrowdSteering"), SteeredUnits.Num(), MinUnitsPerBatch, [this](int32 SteeredIndex)
+    {
+        const int32 Index = SteeredUnits[SteeredIndex];
+
+        // Reduced-rate units catch up on every step since they were last simulated in one go
+        const float DeltaTime = PendingTimes[Index];
+
+        const FUnitSettings& UnitSettings = Settings[Index];
+        const FVector& CurrentLocation = Positions[Index];
+
+        if (FVector::Dist2D(CurrentLocation, Targets[Index]) <= UnitSettings.AcceptanceRadius)
+        {
+            Flags[Index] &= ~UnitFlag_Moving;
+            Velocities[Index] = FVector::ZeroVector;
+            UNIT_EVENT(Arrive, Units[Index], CurrentLocation, Targets[Index]);
+            return;
+        }
+
+        UNIT_EVENT(Steer, Units[Index], CurrentLocation, Targets[Index]);
+
+        FVector DirectionToTarget = GetDesiredDirection(Index);
+
+        // Stuck for more than a second; a small random offset helps it slide free
+        if (StuckTimes[Index] > 1.0f)
+        {
+            FRandomStream Jitter(int32(HashCombineFast(JitterSeeds[Index], StepCount)));
+            DirectionToTarget += FVector(Jitter.FRandRange(-0.3f, 0.3f), Jitter.FRandRange(-0.3f, 0.3f), 0);
+            DirectionToTarget.Normalize();
+            StuckTimes[Index] = 0.0f;
+        }
+
+        if (UnitSettings.AvoidanceMode == EUnitAvoidanceMode::Orca)
+        {
+            Velocities[Index] = SolveOrcaVelocity(Index, DirectionToTarget * UnitSettings.MaxSpeed, DeltaTime);
+
+            const FVector Heading = Velocities[Index].GetSafeNormal2D();
+            if (!Heading.IsNearlyZero())
+            {
+                Yaws[Index] = FMath::RInterpTo(FRotator(0.0f, Yaws[Index], 0.0f), Heading.Rotation(), DeltaTime, UnitSettings.RotationSpeed).Yaw;
+            }
+            return;
+        }
+
+        // Push away from nearby units, more strongly the closer they are. The hash visits them in the
+        // same order on every thread, so the sum comes out bit-identical however the batches are split.
+        FVector AvoidanceVector = FVector::ZeroVector;
+        int32 AvoidCount = 0;
+
+        SpatialHash.ForEachInRadius(CurrentLocation, UnitSettings.AvoidanceRadius, [&](int32 Neighbor, float DistSquared)
+        {
+            const float Distance = FVector::Dist2D(CurrentLocation, Positions[Neighbor]);
+            if (Neighbor != Index && Distance < UnitSettings.AvoidanceRadius)
+            {
+                const FVector AwayFromOther = (CurrentLocation - Positions[Neighbor]).GetSafeNormal2D();
+                const float AvoidanceStrength = FMath::Square(1.0f - (Distance / UnitSettings.AvoidanceRadius));
+
+                AvoidanceVector += AwayFromOther * AvoidanceStrength;
+                AvoidCount++;
+            }
+        });
+
+        // Blend avoidance with movement direction, at most 70% avoidance
+        FVector FinalDirection = DirectionToTarget;
+        if (AvoidCount > 0)
+        {
+            AvoidanceVector /= AvoidCount;
+            const float BlendFactor = FMath::Clamp(AvoidanceVector.Size(), 0.0f, 0.7f);
+            FinalDirection = FMath::Lerp(DirectionToTarget, AvoidanceVector, BlendFactor).GetSafeNormal();
+        }
+
+        // Accelerate towards full speed along the blended direction
+        const FVector DesiredVelocity = FinalDirection * UnitSettings.MaxSpeed;
+        Velocities[Index] += (DesiredVelocity - Velocities[Index]).GetClampedToMaxSize(UnitSettings.Acceleration * DeltaTime);
+
+        // Turn smoothly towards the blended direction
+        if (!FinalDirection.IsNearlyZero())
+        {
+            Yaws[Index] = FMath::RInterpTo(FRotator(0.0f, Yaws[Index], 0.0f), FinalDirection.Rotation(), DeltaTime, UnitSettings.RotationSpeed).Yaw;
+        }
+    });
+}
+
+FVector UCrowdSubsystem::GetDesiredDirection(int32 Index) const
+{
+    const FVector ToTarget = Targets[Index] - Positions[Index];
+
+    const int32 GroupId = GroupIds[Index];
+    if (GroupId != INDEX_NONE && MoveGroups[GroupId].FlowField && ToTarget.SizeSquared2D() > FMath::Square(FinalApproachDistance))
+    {
+        // Zero on the goal cell and where the goal can't be reached; seeking straight is the best left then
+        const FVector FlowDirection = MoveGroups[GroupId].FlowField->GetFlowDirection(Positions[Index]).GetSafeNormal2D();
+        if (!FlowDirection.IsNearlyZero())
+            return FlowDirection;
+    }
+
+    return ToTarget.GetSafeNormal2D();
+}
+
+FVector UCrowdSubsystem::SolveOrcaVelocity(int32 Index, const FVector& PreferredVelocity, float DeltaTime) const
+{
+    const FUnitSettings& UnitSettings = Settings[Index];
+
+    struct FCandidate
+    {
+        int32 Index;
+        float DistSquared;
+    };
+
+    TArray<FCandidate, TInlineAllocator<32>> Candidates;
+    SpatialHash.ForEachInRadius(Positions[Index], UnitSettings.AvoidanceRadius, [&Candidates, Index](int32 Neighbor, float DistSquared)
+    {
+        if (Neighbor != Index)
+        {
+            Candidates.Add({ Neighbor, DistSquared });
+        }
+    });
+
+    // Keep the nearest, breaking ties by slot so every thread picks the same ones
+    if (Candidates.Num() > MaxOrcaNeighbors)
+    {
+        Candidates.Sort([](const FCandidate& A, const FCandidate& B) { return A.DistSquared != B.DistSquared ? A.DistSquared < B.DistSquared : A.Index < B.Index; });
+        Candidates.SetNum(MaxOrcaNeighbors, false);
+    }
+
+    TArray<FOrcaAgent, TInlineAllocator<32>> Neighbors;
+    for (const FCandidate& Candidate : Candidates)
+    {
+        // Units that are parked or steering the old way won't move aside, so this one does all the avoiding
+        const bool bReciprocal = (StartFlags[Candidate.Index] & UnitFlag_Moving) && Settings[Candidate.Index].AvoidanceMode == EUnitAvoidanceMode::Orca;
+        Neighbors.Add({ FVector2D(Positions[Candidate.Index]), FVector2D(StartVelocities[Candidate.Index]), Settings[Candidate.Index].CollisionRadius, bReciprocal });
+    }
+
+    const FOrcaAgent Agent = { FVector2D(Positions[Index]), FVector2D(StartVelocities[Index]), UnitSettings.CollisionRadius, true };
+    const FVector2D NewVelocity = FOrcaSolver::ComputeVelocity(Agent, FVector2D(PreferredVelocity), UnitSettings.MaxSpeed, Neighbors, OrcaTimeHorizon, DeltaTime);
+    return FVector(NewVelocity, 0.0f);
+}
+
+void UCrowdSubsystem::IntegrateAndWriteBack()
+{
+    // Held only for this pass, so edits between steps don't have to copy the grid
+    const UFlowFieldSubsystem* FlowFieldSubsystem = GetWorld()->GetSubsystem<UFlowFieldSubsystem>();
+    const TSharedPtr<const FFlowFieldCostField> CostField = FlowFieldSubsystem ? FlowFieldSubsystem->GetCostField() : nullptr;
+    const FFlowFieldLayout Layout = FlowFieldSubsystem ? FlowFieldSubsystem->GetLayout() : FFlowFieldLayout();
+
+    for (int32 Index : SteeredUnits)
+    {
+        const float DeltaTime = PendingTimes[Index];
+        PendingTimes[Index] = 0.0f;
+
+        if (!(Flags[Index] & UnitFlag_Moving))
+        {
+            // Arrived during steering; group bookkeeping can't be touched from the worker threads
+            LeaveMoveGroup(Index);
+            StuckTimes[Index] = 0.0f;
+
+            // A reduced-rate unit is shown behind its simulated position, so catch it up now that it has stopped
+            if (TickBuckets[Index] == ECrowdTickBucket::Reduced)
+            {
+                Units[Index]->SetActorLocationAndRotation(Positions[Index], FRotator(0.0f, Yaws[Index], 0.0f));
+            }
+            PreviousPositions[Index] = Positions[Index];
+            TickBuckets[Index] = ECrowdTickBucket::Dormant;
+            continue;
+        }
+
+        const FVector OldLocation = Positions[Index];
+        const FVector NewLocation = OldLocation + Velocities[Index] * DeltaTime;
+        PreviousPositions[Index] = OldLocation;
+
+        // Reduced-rate units aren't swept whatever their mode. They are far away or out of sight, so keeping them
+        // out of blocked cells is enough; they are drawn below.
+        if (TickBuckets[Index] == ECrowdTickBucket::Reduced)
+        {
+            Positions[Index] = ResolveAgainstCostField(Layout, CostField.Get(), OldLocation, NewLocation, Settings[Index].CollisionRadius);
+            StuckTimes[Index] = 0.0f;
+            continue;
+        }
+
+        AUnit* Unit = Units[Index];
+        if (Settings[Index].MovementMode == EUnitMovementMode::Kinematic)
+        {
+            Positions[Index] = ResolveAgainstCostField(Layout, CostField.Get(), OldLocation, NewLocation, Settings[Index].CollisionRadius);
+            Unit->SetActorLocationAndRotation(Positions[Index], FRotator(0.0f, Yaws[Index], 0.0f));
+        }
+        else
+        {
+            Unit->SetActorLocationAndRotation(NewLocation, FRotator(0.0f, Yaws[Index], 0.0f), bSweepUnitMoves);
+
+            // A sweep may have stopped short, so the actor has the final say on where the unit ended up
+            Positions[Index] = bSweepUnitMoves ? Unit->GetActorLocation() : NewLocation;
+        }
+        PreviousPositions[Index] = Positions[Index];
+
+        if (FVector::Dist(Positions[Index], OldLocation) < 1.0f)
+        {
+            StuckTimes[Index] += DeltaTime;
+        }
+        else
+        {
+            StuckTimes[Index] = 0.0f;
+        }
+    }
+
+    if (SteeredUnits.Num() > 0)
+    {
+        bHashDirty = true;
+    }
+
+    // Show reduced-rate units moving smoothly between their last two simulated positions, one interval behind
+    for (int32 Index : ActiveUnits)
+    {
+        if (TickBuckets[Index] != ECrowdTickBucket::Reduced || !(Flags[Index] & UnitFlag_Moving))
+            continue;
+
+        const float Alpha = float(GetReducedRatePhase(Index)) / float(ReducedRateInterval);
+        Units[Index]->SetActorLocationAndRotation(FMath::Lerp(PreviousPositions[Index], Positions[Index], Alpha), FRotator(0.0f, Yaws[Index], 0.0f));
+    }
+}
+
+FVector UCrowdSubsystem::ResolveAgainstCostField(const FFlowFieldLayout& Layout, const FFlowFieldCostField* CostField,
+    const FVector& From, const FVector& To, float Radius)
+{
+    if (!CostField)
+        return To;
+
+    // Off the grid there is nothing to say the ground is blocked
+    auto IsBlocked = [&Layout, CostField](double X, double Y)
+    {
+        const FIntPoint Cell = Layout.WorldToCell(FVector(X, Y, 0.0));
+        return Layout.IsValidCell(Cell) && CostField->GetCost(Cell) == FFlowFieldCostField::Impassable;
+    };
+
+    // Already inside a blocked cell, e.g. one built over; let it walk out
+    if (IsBlocked(From.X, From.Y))
+        return To;
+
+    // One axis at a time, testing the leading edge of the unit, so a unit meeting a wall at an angle slides along it
+    FVector Result = To;
+    const FVector Delta = To - From;
+    if (IsBlocked(To.X + FMath::Sign(Delta.X) * Radius, From.Y))
+    {
+        Result.X = From.X;
+    }
+    if (IsBlocked(Result.X, To.Y + FMath::Sign(Delta.Y) * Radius))
+    {
+        Result.Y = From.Y;
+    }
+    return Result;
+}
+
+void UCrowdSubsystem::MoveUnitTo(AUnit* Unit, const FVector& Destination)
+{
+    if (!IsValidSlot(Unit))
+        return;
+
+    const int32 Index = Unit->CrowdIndex;
+    LeaveMoveGroup(Index);
+    UNIT_EVENT(MoveOrder, Unit, Positions[Index], Destination);
+    Targets[Index] = Destination;
+    Flags[Index] |= UnitFlag_Moving;
+    StuckTimes[Index] = 0.0f;
+
+    // A parked unit has no time owed; one already moving keeps its place in the stagger
+    if (TickBuckets[Index] == ECrowdTickBucket::Dormant)
+    {
+        PendingTimes[Index] = 0.0f;
+        PreviousPositions[Index] = Positions[Index];
+    }
+}
+
+void UCrowdSubsystem::MoveGroupTo(TArrayView<AUnit* const> Group, const FVector& Destination)
+{
+    const int32 GroupId = MoveGroups.Add(FMoveGroup());
+
+    for (AUnit* Unit : Group)
+    {
+        // Listed twice; moving it again would take it out of this group
+        if (!IsValidSlot(Unit) || GroupIds[Unit->CrowdIndex] == GroupId)
+            continue;
+
+        MoveUnitTo(Unit, Destination);
+        GroupIds[Unit->CrowdIndex] = GroupId;
+        ++MoveGroups[GroupId].NumUnits;
+    }
+
+    if (MoveGroups[GroupId].NumUnits == 0)
+    {
+        MoveGroups.RemoveAt(GroupId);
+        return;
+    }
+
+    // One request for the whole order. A cache hit calls back before this returns.
+    if (UFlowFieldSubsystem* FlowFieldSubsystem = GetWorld()->GetSubsystem<UFlowFieldSubsystem>())
+    {
+        const uint64 RequestId = FlowFieldSubsystem->RequestFlowField(Destination, FOnFlowFieldReady::CreateUObject(this, &UCrowdSubsystem::OnGroupFlowFieldReady, GroupId));
+        if (MoveGroups.IsValidIndex(GroupId) && !MoveGroups[GroupId].FlowField)
+        {
+            MoveGroups[GroupId].RequestId = RequestId;
+        }
+    }
+}
+
+void UCrowdSubsystem::OnGroupFlowFieldReady(TSharedPtr<const IFlowField> FlowField, int32 GroupId)
+{
+    // Freeing a group cancels its request, so the group here is still the one that asked.
+    // A null field means the destination is off the grid or walled in, and the group keeps seeking straight.
+    FMoveGroup& Group = MoveGroups[GroupId];
+    Group.FlowField = MoveTemp(FlowField);
+    Group.RequestId = 0;
+}
+
+void UCrowdSubsystem::LeaveMoveGroup(int32 Index)
+{
+    const int32 GroupId = GroupIds[Index];
+    if (GroupId == INDEX_NONE)
+        return;
+
+    GroupIds[Index] = INDEX_NONE;
+    if (--MoveGroups[GroupId].NumUnits == 0)
+    {
+        FreeMoveGroup(GroupId);
+    }
+}
+
+void UCrowdSubsystem::FreeMoveGroup(int32 GroupId)
+{
+    const uint64 RequestId = MoveGroups[GroupId].RequestId;
+    if (RequestId != 0)
+    {
+        if (UFlowFieldSubsystem* FlowFieldSubsystem = GetWorld()->GetSubsystem<UFlowFieldSubsystem>())
+        {
+            FlowFieldSubsystem->CancelFlowFieldRequest(RequestId);
+        }
+    }
+    MoveGroups.RemoveAt(GroupId);
+}
+
+void UCrowdSubsystem::StopUnit(AUnit* Unit)
+{
+    if (!IsValidSlot(Unit))
+        return;
+
+    const int32 Index = Unit->CrowdIndex;
+    LeaveMoveGroup(Index);
+    Flags[Index] &= ~UnitFlag_Moving;
+    Velocities[Index] = FVector::ZeroVector;
+
+    // Stop where the unit is shown, which for a reduced-rate unit is behind where it was simulated
+    Positions[Index] = Unit->GetActorLocation();
+    PreviousPositions[Index] = Positions[Index];
+    PendingTimes[Index] = 0.0f;
+    TickBuckets[Index] = ECrowdTickBucket::Dormant;
+    bHashDirty = true;
+}
+
+bool UCrowdSubsystem::IsUnitMoving(const AUnit* Unit) const
+{
+    return IsValidSlot(Unit) && (Flags[Unit->CrowdIndex] & UnitFlag_Moving) != 0;
+}
+
+FVector UCrowdSubsystem::GetUnitVelocity(const AUnit* Unit) const
+{
+    return IsValidSlot(Unit) ? Velocities[Unit->CrowdIndex] : FVector::ZeroVector;
+}
+
+bool UCrowdSubsystem::IsValidSlot(const AUnit* Unit) const
+{
+    return Unit && Units.IsValidIndex(Unit->CrowdIndex) && Units[Unit->CrowdIndex] == Unit;
+}
+
+void UCrowdSubsystem::FindUnitsInRadius(const FVector& Center, float Radius, TArray<AUnit*>& OutUnits) const
+{
+    TArray<int32> Indices;
+    SpatialHash.QueryRadius(Center, Radius, Indices);
+
+    for (int32 Index : Indices)
+    {
+        if (Units[Index])
+        {
+            OutUnits.Add(Units[Index]);
+        }
+    }
+}
+
+void UCrowdSubsystem::FindNearestUnits(const FVector& Center, int32 Count, float MaxRadius, TArray<AUnit*>& OutUnits) const
+{
+    TArray<int32> Indices;
+    SpatialHash.QueryNearest(Center, Count, MaxRadius, Indices);
+
+    for (int32 Index : Indices)
+    {
+        if (Units[Index])
+        {
+            OutUnits.Add(Units[Index]);
+        }
+    }
+}
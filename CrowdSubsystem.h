@@ -0,0 +1,215 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UnitSpatialHash.h"
+#include "CrowdSubsystem.generated.h"
+
+class AUnit;
+class IFlowField;
+enum class EUnitAvoidanceMode : uint8;
+enum class EUnitMovementMode : uint8;
+struct FFlowFieldCostField;
+struct FFlowFieldLayout;
+
+// How often the crowd simulates a unit, from how much it matters this step
+enum class ECrowdTickBucket : uint8
+{
+    // Parked; costs nothing until an order wakes it
+    Dormant,
+
+    // Moving near the camera and on screen; simulated every step
+    Full,
+
+    // Moving far from the camera or off screen; simulated every few steps and interpolated in between
+    Reduced,
+
+    Num
+};
+
+// Simulates every unit in the world in one batched pass. Unit state lives here in parallel arrays indexed by
+// crowd slot, and AUnit actors only show the result: steering, avoidance and integration run over the arrays,
+// then each moved unit's transform is written back once. Steering is spread across worker threads and gives
+// the same result however many there are.
+// Neighbour queries are answered from a spatial hash rebuilt at the start of each step.
+// Units ordered together share one flow field to the order target and only seek in a straight line once close.
+// Only moving units are simulated, and those far from the camera or off screen are simulated at a reduced rate.
+UCLASS(config=Game)
+class PROTOTYPE1_API UCrowdSubsystem : public UTickableWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    UCrowdSubsystem();
+
+    virtual void Deinitialize() override;
+    virtual void Tick(float DeltaTime) override;
+    virtual TStatId GetStatId() const override;
+
+    // Add a unit at its current transform, taking its movement settings from its properties
+    void RegisterUnit(AUnit* Unit);
+
+    // Remove a unit. Its slot is freed at the start of the next step, so hash results stay valid until then.
+    void UnregisterUnit(AUnit* Unit);
+
+    void MoveUnitTo(AUnit* Unit, const FVector& Destination);
+
+    // Send several units to one destination along a single flow field, requested once for the whole group.
+    // Units head straight for the destination until the field arrives.
+    void MoveGroupTo(TArrayView<AUnit* const> Group, const FVector& Destination);
+
+    void StopUnit(AUnit* Unit);
+    bool IsUnitMoving(const AUnit* Unit) const;
+    FVector GetUnitVelocity(const AUnit* Unit) const;
+
+    int32 GetNumUnits() const { return Units.Num(); }
+
+    // Units in each tick bucket, and how many were actually simulated, as of the last step
+    int32 GetNumUnitsInBucket(ECrowdTickBucket Bucket) const { return BucketCounts[static_cast<int32>(Bucket)]; }
+    int32 GetNumUnitsSimulated() const { return SteeredUnits.Num(); }
+
+    // Units that were within Radius of Center at the start of the step, ignoring height
+    void FindUnitsInRadius(const FVector& Center, float Radius, TArray<AUnit*>& OutUnits) const;
+
+    // Up to Count units nearest Center at the start of the step and no further than MaxRadius, closest first
+    void FindNearestUnits(const FVector& Center, int32 Count, float MaxRadius, TArray<AUnit*>& OutUnits) const;
+
+protected:
+    // Width of a hash cell; about the largest query radius keeps most queries to a 3x3 block of cells
+    UPROPERTY(Config)
+    float HashCellSize;
+
+    // Sweep units against the world when writing their moves back, so they stop at walls and buildings
+    UPROPERTY(Config)
+    bool bSweepUnitMoves;
+
+    // How far ahead, in seconds, ORCA units make sure they won't collide
+    UPROPERTY(Config)
+    float OrcaTimeHorizon;
+
+    // Closest neighbours an ORCA unit takes into account; more cost more and rarely change the result
+    UPROPERTY(Config)
+    int32 MaxOrcaNeighbors;
+
+    // Distance from its destination at which a grouped unit stops following the flow field and heads straight there.
+    // Flow directions point at cell centres, so this should be at least a cell or two.
+    UPROPERTY(Config)
+    float FinalApproachDistance;
+
+    // Moving units further than this from the camera, or not rendered lately, drop to the reduced rate
+    UPROPERTY(Config)
+    float ReducedRateDistance;
+
+    // Steps between updates of a reduced-rate unit. Units are staggered across them so the work stays even.
+    UPROPERTY(Config)
+    int32 ReducedRateInterval;
+
+private:
+    enum EUnitFlags : uint8
+    {
+        UnitFlag_Moving = 1 << 0,
+        UnitFlag_PendingRemoval = 1 << 1,
+    };
+
+    // Per-unit tuning, read once when the unit registers
+    struct FUnitSettings
+    {
+        float MaxSpeed;
+        float Acceleration;
+        float RotationSpeed;
+        float AcceptanceRadius;
+        float AvoidanceRadius;
+        float CollisionRadius;
+        EUnitAvoidanceMode AvoidanceMode;
+        EUnitMovementMode MovementMode;
+    };
+
+    // Units sent somewhere by one group order, and the flow field they share once it's built
+    struct FMoveGroup
+    {
+        TSharedPtr<const IFlowField> FlowField;
+        uint64 RequestId = 0;
+        int32 NumUnits = 0;
+    };
+
+    // Free the slots of units unregistered since the last step, filling them from the end
+    void RemovePendingUnits();
+
+    // Sort moving units into tick buckets and pick the ones due for simulation this step
+    void GatherActiveUnits(float DeltaTime);
+
+    // Steps since a reduced-rate unit was last simulated; zero on the steps it is
+    int32 GetReducedRatePhase(int32 Index) const;
+
+    void OnGroupFlowFieldReady(TSharedPtr<const IFlowField> FlowField, int32 GroupId);
+
+    // Take a unit out of its move group, freeing the group when it was the last one
+    void LeaveMoveGroup(int32 Index);
+    void FreeMoveGroup(int32 GroupId);
+
+    // Direction a moving unit wants to go: along its group's flow field, or straight at its target
+    FVector GetDesiredDirection(int32 Index) const;
+
+    // Desired direction, avoidance, acceleration and facing for every unit due this step, run in parallel.
+    // Positions are only read, so every unit sees where the others were at the start of the step,
+    // and each unit writes only to its own slot of the other arrays.
+    void UpdateSteering();
+
+    // Collision-free velocity for an ORCA unit, from the nearest units within its avoidance radius
+    FVector SolveOrcaVelocity(int32 Index, const FVector& PreferredVelocity, float DeltaTime) const;
+
+    // Advance simulated units by their new velocities and write moving units back to their actors, on the game thread.
+    // Reduced-rate units are shown part way between their last two simulated positions.
+    void IntegrateAndWriteBack();
+
+    // Move from From towards To without entering an impassable cell, sliding along blocked cells one axis at a time.
+    // For units that aren't swept against the world. Returns To when there is no cost field.
+    static FVector ResolveAgainstCostField(const FFlowFieldLayout& Layout, const FFlowFieldCostField* CostField,
+        const FVector& From, const FVector& To, float Radius);
+
+    bool IsValidSlot(const AUnit* Unit) const;
+
+    // Indexed by crowd slot; the unit's own slot is stored on the unit
+    UPROPERTY()
+    TArray<AUnit*> Units;
+
+    TArray<FVector> Positions;
+    TArray<FVector> Velocities;
+    TArray<FVector> Targets;
+    TArray<float> Yaws;
+    TArray<float> StuckTimes;
+    TArray<uint8> Flags;
+    TArray<FUnitSettings> Settings;
+
+    // Time since each unit was last simulated, which is the step it takes when it next is
+    TArray<float> PendingTimes;
+
+    // Simulated position before the last step, for interpolating reduced-rate units
+    TArray<FVector> PreviousPositions;
+    TArray<ECrowdTickBucket> TickBuckets;
+
+    // Index into MoveGroups, or INDEX_NONE for units moving on their own
+    TArray<int32> GroupIds;
+
+    // Neighbour state as it was at the start of the step, since steering overwrites the live arrays as it goes
+    TArray<FVector> StartVelocities;
+    TArray<uint8> StartFlags;
+
+    // Per-unit seed for the unstick offset, mixed with StepCount so it doesn't depend on thread scheduling
+    TArray<uint32> JitterSeeds;
+    uint32 StepCount;
+
+    int32 NumPendingRemovals;
+
+    // Slots of every moving unit, and of those simulated this step
+    TArray<int32> ActiveUnits;
+    TArray<int32> SteeredUnits;
+    int32 BucketCounts[static_cast<int32>(ECrowdTickBucket::Num)];
+
+    // Set when positions or slots change, so a parked crowd doesn't rebuild the hash every step
+    bool bHashDirty;
+
+    TSparseArray<FMoveGroup> MoveGroups;
+
+    FUnitSpatialHash SpatialHash;
+};
@@ -0,0 +1,728 @@
+#include "FlowField.h"
+#include "HAL/IConsoleManager.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/Unique.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY
+#include <emmintrin.h>
+#define FLOWFIELD_SSE2_DIRECTIONS 1
+#else
+#define FLOWFIELD_SSE2_DIRECTIONS 0
+#endif
+
+static const FIntPoint NeighborOffsets[] = { FIntPoint(1, 0), FIntPoint(-1, 0), FIntPoint(0, 1), FIntPoint(0, -1) };
+
+// Unit vectors for the packed direction codes, counter-clockwise from +X
+static const FVector2f DirectionVectors[] =
+{
+    FVector2f(1.0f, 0.0f), FVector2f(UE_INV_SQRT_2, UE_INV_SQRT_2), FVector2f(0.0f, 1.0f), FVector2f(-UE_INV_SQRT_2, UE_INV_SQRT_2),
+    FVector2f(-1.0f, 0.0f), FVector2f(-UE_INV_SQRT_2, -UE_INV_SQRT_2), FVector2f(0.0f, -1.0f), FVector2f(UE_INV_SQRT_2, -UE_INV_SQRT_2)
+};
+
+namespace FlowFieldDirection
+{
+    constexpr uint8 East = 0;
+    constexpr uint8 North = 2;
+    constexpr uint8 West = 4;
+    constexpr uint8 South = 6;
+}
+
+// Direction for one cell: the first strictly cheaper neighbour, checked east, west, north, south
+static FORCEINLINE uint8 ChooseDirection(const uint16* Costs, int32 Index, int32 X, int32 Y, int32 Width, int32 Height)
+{
+    uint16 LowestCost = Costs[Index];
+    uint8 Direction = FFlowField::NoDirection;
+
+    if (X + 1 < Width && Costs[Index + 1] < LowestCost)
+    {
+        LowestCost = Costs[Index + 1];
+        Direction = FlowFieldDirection::East;
+    }
+    if (X > 0 && Costs[Index - 1] < LowestCost)
+    {
+        LowestCost = Costs[Index - 1];
+        Direction = FlowFieldDirection::West;
+    }
+    if (Y + 1 < Height && Costs[Index + Width] < LowestCost)
+    {
+        LowestCost = Costs[Index + Width];
+        Direction = FlowFieldDirection::North;
+    }
+    if (Y > 0 && Costs[Index - Width] < LowestCost)
+    {
+        Direction = FlowFieldDirection::South;
+    }
+
+    return Direction;
+}
+
+static void CalculateDirectionsScalar(const uint16* Costs, uint8* OutDirections, int32 Width, int32 Height, const FIntRect& Rect)
+{
+    for (int32 Y = Rect.Min.Y; Y < Rect.Max.Y; ++Y)
+    {
+        for (int32 X = Rect.Min.X; X < Rect.Max.X; ++X)
+        {
+            const int32 Index = Y * Width + X;
+            OutDirections[Index] = ChooseDirection(Costs, Index, X, Y, Width, Height);
+        }
+    }
+}
+
+#if FLOWFIELD_SSE2_DIRECTIONS
+// Take Candidate's lanes where it is strictly cheaper than Best, tagging them with Code
+static FORCEINLINE void SelectCheaper(__m128i& Best, __m128i& Direction, __m128i Candidate, __m128i Code)
+{
+    const __m128i Mask = _mm_cmplt_epi16(Candidate, Best);
+    Best = _mm_or_si128(_mm_and_si128(Mask, Candidate), _mm_andnot_si128(Mask, Best));
+    Direction = _mm_or_si128(_mm_and_si128(Mask, Code), _mm_andnot_si128(Mask, Direction));
+}
+
+// Same result as CalculateDirectionsScalar, eight cells at a time.
+// SSE2 only compares signed 16-bit lanes, so costs are biased by 0x8000 to keep their unsigned order.
+// Missing rows above and below the grid read as a constant unreachable vector instead of being bounds checked,
+// and the first and last column are left to the scalar path so loads never run off the end of a row.
+static void CalculateDirectionsSSE2(const uint16* Costs, uint8* OutDirections, int32 Width, int32 Height, const FIntRect& Rect)
+{
+    const __m128i Bias = _mm_set1_epi16(int16(0x8000));
+    const __m128i Unreachable = _mm_set1_epi16(int16(FFlowField::UnreachedCost ^ 0x8000));
+    const __m128i NoDirection = _mm_set1_epi16(FFlowField::NoDirection);
+    const __m128i East = _mm_set1_epi16(FlowFieldDirection::East);
+    const __m128i West = _mm_set1_epi16(FlowFieldDirection::West);
+    const __m128i North = _mm_set1_epi16(FlowFieldDirection::North);
+    const __m128i South = _mm_set1_epi16(FlowFieldDirection::South);
+
+    auto LoadBiased = [Bias](const uint16* Source) { return _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Source)), Bias); };
+
+    const int32 VectorStart = FMath::Clamp(1, Rect.Min.X, Rect.Max.X);
+    const int32 VectorEnd = FMath::Min(Rect.Max.X, Width - 1);
+
+    for (int32 Y = Rect.Min.Y; Y < Rect.Max.Y; ++Y)
+    {
+        const uint16* Row = Costs + Y * Width;
+        const uint16* RowUp = Y + 1 < Height ? Row + Width : nullptr;
+        const uint16* RowDown = Y > 0 ? Row - Width : nullptr;
+        uint8* OutRow = OutDirections + Y * Width;
+
+        int32 X = Rect.Min.X;
+        for (; X < VectorStart; ++X)
+        {
+            OutRow[X] = ChooseDirection(Costs, Y * Width + X, X, Y, Width, Height);
+        }
+
+        for (; X + 8 <= VectorEnd; X += 8)
+        {
+            __m128i Best = LoadBiased(Row + X);
+            __m128i Direction = NoDirection;
+            SelectCheaper(Best, Direction, LoadBiased(Row + X + 1), East);
+            SelectCheaper(Best, Direction, LoadBiased(Row + X - 1), West);
+            SelectCheaper(Best, Direction, RowUp ? LoadBiased(RowUp + X) : Unreachable, North);
+            SelectCheaper(Best, Direction, RowDown ? LoadBiased(RowDown + X) : Unreachable, South);
+
+            // Codes are 0-6 or 0xFF, all of which survive the saturating pack to bytes
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(OutRow + X), _mm_packus_epi16(Direction, Direction));
+        }
+
+        for (; X < Rect.Max.X; ++X)
+        {
+            OutRow[X] = ChooseDirection(Costs, Y * Width + X, X, Y, Width, Height);
+        }
+    }
+}
+#endif
+
+FIntPoint FFlowFieldLayout::WorldToCell(const FVector& WorldLocation) const
+{
+    FVector LocalLocation = WorldLocation - Origin;
+    return FIntPoint(
+        FMath::FloorToInt(LocalLocation.X / CellSize),
+        FMath::FloorToInt(LocalLocation.Y / CellSize)
+    );
+}
+
+FIntRect FFlowFieldLayout::WorldToCellRect(const FBox& WorldBounds) const
+{
+    const FVector LocalMin = (WorldBounds.Min - Origin) / CellSize;
+    const FVector LocalMax = (WorldBounds.Max - Origin) / CellSize;
+    return FIntRect(
+        FMath::CeilToInt(LocalMin.X - 0.5f), FMath::CeilToInt(LocalMin.Y - 0.5f),
+        FMath::FloorToInt(LocalMax.X - 0.5f) + 1, FMath::FloorToInt(LocalMax.Y - 0.5f) + 1
+    );
+}
+
+FVector FFlowFieldLayout::CellToWorld(const FIntPoint& Cell) const
+{
+    return Origin + FVector(
+        Cell.X * CellSize + CellSize * 0.5f,
+        Cell.Y * CellSize + CellSize * 0.5f,
+        0.0f
+    );
+}
+
+FFlowFieldLayout FFlowFieldLayout::GetSubLayout(const FIntRect& Rect) const
+{
+    FFlowFieldLayout SubLayout;
+    SubLayout.Origin = Origin + FVector(Rect.Min.X * CellSize, Rect.Min.Y * CellSize, 0.0f);
+    SubLayout.CellSize = CellSize;
+    SubLayout.Width = Rect.Width();
+    SubLayout.Height = Rect.Height();
+    SubLayout.GridOffset = GridOffset + Rect.Min;
+    return SubLayout;
+}
+
+FFlowFieldGoal FFlowFieldGoal::MakePoint(const FFlowFieldLayout& Layout, const FVector& WorldLocation)
+{
+    const FIntPoint Cell = Layout.WorldToCell(WorldLocation);
+    return MakeCells(Layout, MakeArrayView(&Cell, 1));
+}
+
+FFlowFieldGoal FFlowFieldGoal::MakeBox(const FFlowFieldLayout& Layout, const FBox& WorldBounds)
+{
+    FIntRect Rect = Layout.WorldToCellRect(WorldBounds);
+    Rect.Clip(FIntRect(0, 0, Layout.Width, Layout.Height));
+
+    FFlowFieldGoal Goal;
+    for (int32 Y = Rect.Min.Y; Y < Rect.Max.Y; ++Y)
+    {
+        for (int32 X = Rect.Min.X; X < Rect.Max.X; ++X)
+        {
+            Goal.Cells.Add(FIntPoint(X, Y));
+        }
+    }
+    Goal.Normalize();
+    return Goal;
+}
+
+FFlowFieldGoal FFlowFieldGoal::MakeCircle(const FFlowFieldLayout& Layout, const FVector& Center, float Radius)
+{
+    FFlowFieldGoal Goal = MakeBox(Layout, FBox::BuildAABB(Center, FVector(Radius, Radius, 0.0f)));
+    Goal.Cells.RemoveAll([&Layout, &Center, Radius](const FIntPoint& Cell) { return FVector::DistSquared2D(Layout.CellToWorld(Cell), Center) > FMath::Square(Radius); });
+    Goal.Normalize();
+    return Goal;
+}
+
+FFlowFieldGoal FFlowFieldGoal::MakeRing(const FFlowFieldLayout& Layout, const FBox& Footprint, int32 RingWidth)
+{
+    // A footprint smaller than a cell may not contain any cell centre; treat it as the cell it sits in
+    FIntRect Inner = Layout.WorldToCellRect(Footprint);
+    if (Inner.Area() <= 0)
+    {
+        const FIntPoint Cell = Layout.WorldToCell(Footprint.GetCenter());
+        Inner = FIntRect(Cell, Cell + FIntPoint(1, 1));
+    }
+
+    FIntRect Outer(Inner.Min - FIntPoint(RingWidth, RingWidth), Inner.Max + FIntPoint(RingWidth, RingWidth));
+    Outer.Clip(FIntRect(0, 0, Layout.Width, Layout.Height));
+
+    FFlowFieldGoal Goal;
+    for (int32 Y = Outer.Min.Y; Y < Outer.Max.Y; ++Y)
+    {
+        for (int32 X = Outer.Min.X; X < Outer.Max.X; ++X)
+        {
+            if (!Inner.Contains(FIntPoint(X, Y)))
+            {
+                Goal.Cells.Add(FIntPoint(X, Y));
+            }
+        }
+    }
+    Goal.Normalize();
+    return Goal;
+}
+
+FFlowFieldGoal FFlowFieldGoal::MakeCells(const FFlowFieldLayout& Layout, TArrayView<const FIntPoint> InCells)
+{
+    FFlowFieldGoal Goal;
+    for (const FIntPoint& Cell : InCells)
+    {
+        if (Layout.IsValidCell(Cell))
+        {
+            Goal.Cells.Add(Cell);
+        }
+    }
+    Goal.Normalize();
+    return Goal;
+}
+
+void FFlowFieldGoal::Append(const FFlowFieldGoal& Other)
+{
+    Cells.Append(Other.Cells);
+    Normalize();
+}
+
+FIntPoint FFlowFieldGoal::GetAnchorCell() const
+{
+    if (Cells.Num() == 0)
+        return FIntPoint::NoneValue;
+
+    FVector2D Centroid = FVector2D::ZeroVector;
+    for (const FIntPoint& Cell : Cells)
+    {
+        Centroid += FVector2D(Cell);
+    }
+    Centroid /= Cells.Num();
+
+    // The centroid of a ring or of several buildings is usually not a goal cell itself
+    FIntPoint Anchor = Cells[0];
+    double AnchorDistSquared = MAX_dbl;
+    for (const FIntPoint& Cell : Cells)
+    {
+        const double DistSquared = FVector2D::DistSquared(FVector2D(Cell), Centroid);
+        if (DistSquared < AnchorDistSquared)
+        {
+            AnchorDistSquared = DistSquared;
+            Anchor = Cell;
+        }
+    }
+    return Anchor;
+}
+
+void FFlowFieldGoal::Normalize()
+{
+    Cells.Sort([](const FIntPoint& A, const FIntPoint& B) { return A.Y != B.Y ? A.Y < B.Y : A.X < B.X; });
+    Cells.SetNum(Algo::Unique(Cells));
+
+    Hash = GetTypeHash(Cells.Num());
+    for (const FIntPoint& Cell : Cells)
+    {
+        Hash = HashCombineFast(Hash, GetTypeHash(Cell));
+    }
+}
+
+FFlowField::FFlowField(const FFlowFieldLayout& InLayout, const FIntPoint& InTargetCell, TSharedPtr<const FFlowFieldCostField> InCostField)
+    : Layout(InLayout)
+    , TargetCell(InTargetCell)
+    , CostField(MoveTemp(InCostField))
+{
+}
+
+void FFlowField::Build()
+{
+    if (!Layout.IsValidCell(TargetCell))
+    {
+        Build(TArrayView<const FFlowFieldSeed>());
+        return;
+    }
+
+    // Set target cell cost to 0
+    const FFlowFieldSeed TargetSeed = { Layout.CellToIndex(TargetCell), 0 };
+    Build(MakeArrayView(&TargetSeed, 1));
+}
+
+void FFlowField::Build(TArrayView<const FFlowFieldSeed> Seeds)
+{
+    // Reset all cells
+    IntegratedCosts.Init(UnreachedCost, Layout.Num());
+    Directions.Init(NoDirection, Layout.Num());
+    BuildSeeds = Seeds;
+    BuildSeeds.Sort([](const FFlowFieldSeed& A, const FFlowFieldSeed& B) { return A.Index < B.Index; });
+    ++Revision;
+
+    if (Seeds.Num() == 0)
+        return;
+
+    // Propagate costs from the seeds
+    PropagateCosts(Seeds);
+
+    // Calculate flow directions
+    CalculateFlowDirections();
+}
+
+void FFlowField::Build(const FFlowFieldGoal& Goal)
+{
+    // Blocked goal cells are kept as seeds so a repair can bring them back when they clear
+    TArray<FFlowFieldSeed> Seeds;
+    for (const FIntPoint& GridCell : Goal.GetCells())
+    {
+        const FIntPoint Cell = GridCell - Layout.GridOffset;
+        if (Layout.IsValidCell(Cell))
+        {
+            Seeds.Add({ Layout.CellToIndex(Cell), 0 });
+        }
+    }
+    Build(Seeds);
+}
+
+void FFlowField::PropagateCosts(TArrayView<const FFlowFieldSeed> Seeds)
+{
+    // Dial's algorithm: step costs are small integers, so a ring of MaxStepCost + 1
+    // buckets indexed by cost is an O(1) priority queue. Cells come out in cost order
+    // and each one is settled exactly once, making a full pass O(cells).
+    constexpr int32 NumBuckets = MaxStepCost + 1;
+
+    TArray<int32> Buckets[NumBuckets];
+    TBitArray<> Settled(false, IntegratedCosts.Num());
+
+    // Seeds can start at any cost, further apart than the ring is wide, so they are
+    // fed in as the sweep reaches their cost. Sorted descending so Pop gives the cheapest.
+    TArray<FFlowFieldSeed> PendingSeeds(Seeds.GetData(), Seeds.Num());
+    PendingSeeds.RemoveAll([this](const FFlowFieldSeed& Seed) { return IsBlocked(Layout.IndexToCell(Seed.Index)); });
+    if (PendingSeeds.Num() == 0)
+        return;
+
+    PendingSeeds.Sort([](const FFlowFieldSeed& A, const FFlowFieldSeed& B) { return A.Cost > B.Cost; });
+
+    int32 NumQueued = 0;
+    int32 CurrentCost = PendingSeeds.Last().Cost;
+
+    for (; NumQueued > 0 || PendingSeeds.Num() > 0; ++CurrentCost)
+    {
+        // Skip over cost ranges where nothing is queued
+        if (NumQueued == 0)
+        {
+            CurrentCost = FMath::Max(CurrentCost, PendingSeeds.Last().Cost);
+        }
+
+        TArray<int32>& Bucket = Buckets[CurrentCost % NumBuckets];
+
+        while (PendingSeeds.Num() > 0 && PendingSeeds.Last().Cost <= CurrentCost)
+        {
+            const FFlowFieldSeed Seed = PendingSeeds.Pop(false);
+            const int32 SeedCost = FMath::Min<int32>(Seed.Cost, MaxIntegratedCost);
+            if (SeedCost < IntegratedCosts[Seed.Index])
+            {
+                IntegratedCosts[Seed.Index] = SeedCost;
+                Bucket.Add(Seed.Index);
+                ++NumQueued;
+            }
+        }
+
+        while (!Bucket.IsEmpty())
+        {
+            const int32 CurrentIndex = Bucket.Pop(false);
+            --NumQueued;
+
+            // Cells whose cost improved after they were queued leave a stale entry behind
+            if (Settled[CurrentIndex])
+                continue;
+            Settled[CurrentIndex] = true;
+
+            const FIntPoint Current = Layout.IndexToCell(CurrentIndex);
+
+            for (const FIntPoint& Offset : NeighborOffsets)
+            {
+                const FIntPoint Neighbor = Current + Offset;
+                if (!Layout.IsValidCell(Neighbor) || IsBlocked(Neighbor))
+                    continue;
+
+                const int32 NeighborIndex = Layout.CellToIndex(Neighbor);
+                if (Settled[NeighborIndex])
+                    continue;
+
+                // Saturated cells all land in one bucket, which the ring reaches again within NumBuckets steps
+                const int32 NewCost = FMath::Min<int32>(CurrentCost + CalculateCost(Current, Neighbor), MaxIntegratedCost);
+                if (NewCost < IntegratedCosts[NeighborIndex])
+                {
+                    IntegratedCosts[NeighborIndex] = NewCost;
+                    Buckets[NewCost % NumBuckets].Add(NeighborIndex);
+                    ++NumQueued;
+                }
+            }
+        }
+    }
+}
+
+bool FFlowField::Repair(TSharedPtr<const FFlowFieldCostField> NewCostField, TArrayView<const FIntPoint> ChangedGridCells)
+{
+    const TSharedPtr<const FFlowFieldCostField> OldCostField = CostField;
+    CostField = MoveTemp(NewCostField);
+
+    if (!BuildSeeds.ContainsByPredicate([this](const FFlowFieldSeed& Seed) { return !IsBlocked(Layout.IndexToCell(Seed.Index)); }))
+        return false;
+
+    if (IntegratedCosts.Num() == 0)
+        return true;
+
+    TArray<int32> Invalidated;
+    TArray<int32> Lowered;
+    TBitArray<> InvalidatedMask(false, IntegratedCosts.Num());
+
+    for (const FIntPoint& GridCell : ChangedGridCells)
+    {
+        const FIntPoint Cell = GridCell - Layout.GridOffset;
+        if (!Layout.IsValidCell(Cell))
+            continue;
+
+        const uint8 OldStepCost = GetStepCost(OldCostField.Get(), GridCell);
+        const uint8 NewStepCost = GetStepCost(CostField.Get(), GridCell);
+        if (OldStepCost == NewStepCost)
+            continue;
+
+        const int32 Index = Layout.CellToIndex(Cell);
+        if (NewStepCost < OldStepCost)
+        {
+            Lowered.Add(Index);
+        }
+        else if (!InvalidatedMask[Index])
+        {
+            InvalidatedMask[Index] = true;
+            Invalidated.Add(Index);
+        }
+    }
+
+    if (Invalidated.Num() == 0 && Lowered.Num() == 0)
+        return true;
+
+    ++Revision;
+
+    // Everything downhill of a cell that got dearer may have been routed through it. A neighbour
+    // whose cost is exactly its old step cost more than the cell's is treated as routed through it;
+    // some of those had an equally cheap route elsewhere, which only costs a little extra work.
+    for (int32 Cursor = 0; Cursor < Invalidated.Num(); ++Cursor)
+    {
+        const int32 Index = Invalidated[Cursor];
+        const int32 Cost = IntegratedCosts[Index];
+        if (Cost == UnreachedCost)
+            continue;
+
+        const FIntPoint Current = Layout.IndexToCell(Index);
+        for (const FIntPoint& Offset : NeighborOffsets)
+        {
+            const FIntPoint Neighbor = Current + Offset;
+            if (!Layout.IsValidCell(Neighbor))
+                continue;
+
+            const int32 NeighborIndex = Layout.CellToIndex(Neighbor);
+            if (!InvalidatedMask[NeighborIndex] && IntegratedCosts[NeighborIndex] == FMath::Min<int32>(Cost + GetStepCost(OldCostField.Get(), Neighbor + Layout.GridOffset), MaxIntegratedCost))
+            {
+                InvalidatedMask[NeighborIndex] = true;
+                Invalidated.Add(NeighborIndex);
+            }
+        }
+    }
+
+    FIntPoint DirtyMin(MAX_int32, MAX_int32);
+    FIntPoint DirtyMax(MIN_int32, MIN_int32);
+    auto IncludeInDirtyRect = [&](int32 Index)
+    {
+        const FIntPoint Cell = Layout.IndexToCell(Index);
+        DirtyMin = DirtyMin.ComponentMin(Cell);
+        DirtyMax = DirtyMax.ComponentMax(Cell);
+    };
+
+    for (int32 Index : Invalidated)
+    {
+        IntegratedCosts[Index] = UnreachedCost;
+        IncludeInDirtyRect(Index);
+    }
+
+    // The sweep below can start from any cost, so it uses a heap rather than the bucket ring.
+    // Repairs only visit the cells they change, which keeps the heap small.
+    auto CheaperFirst = [](const FFlowFieldSeed& A, const FFlowFieldSeed& B) { return A.Cost < B.Cost; };
+    TArray<FFlowFieldSeed> OpenSet;
+
+    auto QueueFromNeighbors = [&](int32 Index)
+    {
+        const FIntPoint Current = Layout.IndexToCell(Index);
+        if (IsBlocked(Current))
+            return;
+
+        int32 BestCost = IntegratedCosts[Index];
+        for (int32 SeedIndex = Algo::LowerBoundBy(BuildSeeds, Index, &FFlowFieldSeed::Index); SeedIndex < BuildSeeds.Num() && BuildSeeds[SeedIndex].Index == Index; ++SeedIndex)
+        {
+            BestCost = FMath::Min<int32>(BestCost, BuildSeeds[SeedIndex].Cost);
+        }
+
+        for (const FIntPoint& Offset : NeighborOffsets)
+        {
+            const FIntPoint Neighbor = Current + Offset;
+            if (!Layout.IsValidCell(Neighbor))
+                continue;
+
+            const int32 NeighborIndex = Layout.CellToIndex(Neighbor);
+            if (IntegratedCosts[NeighborIndex] != UnreachedCost)
+            {
+                BestCost = FMath::Min(BestCost, IntegratedCosts[NeighborIndex] + CalculateCost(Neighbor, Current));
+            }
+        }
+
+        BestCost = FMath::Min<int32>(BestCost, MaxIntegratedCost);
+        if (BestCost < IntegratedCosts[Index])
+        {
+            IntegratedCosts[Index] = BestCost;
+            OpenSet.HeapPush({ Index, BestCost }, CheaperFirst);
+        }
+    };
+
+    // Refill the hole from its intact rim, and start a lowering wave from each cheaper cell
+    for (int32 Index : Invalidated)
+    {
+        QueueFromNeighbors(Index);
+    }
+    for (int32 Index : Lowered)
+    {
+        QueueFromNeighbors(Index);
+    }
+
+    while (OpenSet.Num() > 0)
+    {
+        FFlowFieldSeed Current;
+        OpenSet.HeapPop(Current, CheaperFirst, false);
+        if (Current.Cost > IntegratedCosts[Current.Index])
+            continue;
+
+        IncludeInDirtyRect(Current.Index);
+
+        const FIntPoint CurrentCell = Layout.IndexToCell(Current.Index);
+        for (const FIntPoint& Offset : NeighborOffsets)
+        {
+            const FIntPoint Neighbor = CurrentCell + Offset;
+            if (!Layout.IsValidCell(Neighbor) || IsBlocked(Neighbor))
+                continue;
+
+            const int32 NeighborIndex = Layout.CellToIndex(Neighbor);
+            const int32 NewCost = FMath::Min<int32>(Current.Cost + CalculateCost(CurrentCell, Neighbor), MaxIntegratedCost);
+            if (NewCost < IntegratedCosts[NeighborIndex])
+            {
+                IntegratedCosts[NeighborIndex] = NewCost;
+                OpenSet.HeapPush({ NeighborIndex, NewCost }, CheaperFirst);
+            }
+        }
+    }
+
+    // Cheaper cells that stayed unreachable still need their stale direction dropped
+    for (int32 Index : Lowered)
+    {
+        IncludeInDirtyRect(Index);
+    }
+
+    // A direction only depends on the costs around it, so one ring past the changed costs is enough
+    FIntRect DirtyRect(DirtyMin - FIntPoint(1, 1), DirtyMax + FIntPoint(2, 2));
+    DirtyRect.Clip(FIntRect(0, 0, Layout.Width, Layout.Height));
+    CalculateFlowDirections(DirtyRect);
+    return true;
+}
+
+bool FFlowField::ApplyChange(const FFlowFieldChange& Change)
+{
+    return Repair(Change.CostField, Change.Cells);
+}
+
+void FFlowField::CalculateFlowDirections()
+{
+    CalculateFlowDirections(FIntRect(0, 0, Layout.Width, Layout.Height));
+}
+
+void FFlowField::CalculateFlowDirections(const FIntRect& Rect)
+{
+    // Row by row over the flat arrays, so neighbours are fixed offsets from the cell's index
+#if FLOWFIELD_SSE2_DIRECTIONS
+    CalculateDirectionsSSE2(IntegratedCosts.GetData(), Directions.GetData(), Layout.Width, Layout.Height, Rect);
+#else
+    CalculateDirectionsScalar(IntegratedCosts.GetData(), Directions.GetData(), Layout.Width, Layout.Height, Rect);
+#endif
+}
+
+FVector2f FFlowField::DecodeDirection(uint8 Direction)
+{
+    return Direction < UE_ARRAY_COUNT(DirectionVectors) ? DirectionVectors[Direction] : FVector2f::ZeroVector;
+}
+
+int32 FFlowField::CalculateCost(const FIntPoint& From, const FIntPoint& To) const
+{
+    // Neighbours are orthogonal, so a step costs whatever the cell being entered costs
+    return GetStepCost(CostField.Get(), To + Layout.GridOffset);
+}
+
+FVector FFlowField::GetFlowDirection(const FVector& WorldLocation) const
+{
+    FIntPoint Cell = Layout.WorldToCell(WorldLocation);
+    if (!Layout.IsValidCell(Cell) || Directions.Num() == 0)
+        return FVector::ZeroVector;
+
+    // Get the flow direction from the grid
+    const int32 Index = Layout.CellToIndex(Cell);
+    const uint8 Direction = Directions[Index];
+
+    // Inside the target cell there is no lower neighbour, so head straight for its centre.
+    // Any other goal cell is already somewhere the unit can stop, so it stays where it is.
+    if (Direction == NoDirection)
+    {
+        if (IntegratedCosts[Index] == 0 && Cell != TargetCell)
+            return FVector::ZeroVector;
+
+        return (Layout.CellToWorld(TargetCell) - WorldLocation).GetSafeNormal2D();
+    }
+
+    // The lookup table is already unit length
+    const FVector2f FlowDirection2D = DecodeDirection(Direction);
+    return FVector(FlowDirection2D.X, FlowDirection2D.Y, 0.0f);
+}
+
+SIZE_T FFlowField::GetAllocatedSize() const
+{
+    return sizeof(*this) + IntegratedCosts.GetAllocatedSize() + Directions.GetAllocatedSize() + BuildSeeds.GetAllocatedSize();
+}
+
+void FFlowField::GatherBuiltFields(TArray<const FFlowField*>& OutFields) const
+{
+    OutFields.Add(this);
+}
+
+int32 FFlowField::GetIntegratedCost(const FIntPoint& Cell) const
+{
+    if (!Layout.IsValidCell(Cell) || IntegratedCosts.Num() == 0)
+        return MAX_int32;
+
+    const uint16 Cost = IntegratedCosts[Layout.CellToIndex(Cell)];
+    return Cost == UnreachedCost ? MAX_int32 : int32(Cost);
+}
+
+// Times the scalar direction pass against the vectorised one on a field with scattered walls and checks they agree.
+// Run from the console: FlowField.BenchmarkDirections [GridSize=512] [Iterations=100]
+static void RunDirectionBenchmark(const TArray<FString>& Args)
+{
+    const int32 Size = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 8) : 512;
+    const int32 Iterations = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 100;
+
+    TSharedRef<FFlowFieldCostField> CostField = MakeShared<FFlowFieldCostField>();
+    CostField->Init(Size, Size);
+    FRandomStream Random(Size);
+    for (uint8& Cost : CostField->Costs)
+    {
+        Cost = Random.FRand() < 0.1f ? FFlowFieldCostField::Impassable : uint8(1 + Random.RandHelper(4));
+    }
+
+    const FIntPoint TargetCell(Size / 2, Size / 2);
+    CostField->Costs[TargetCell.Y * Size + TargetCell.X] = FFlowFieldCostField::Open;
+
+    FFlowFieldLayout Layout;
+    Layout.Width = Size;
+    Layout.Height = Size;
+    FFlowField Field(Layout, TargetCell, CostField);
+    Field.Build();
+
+    const uint16* Costs = Field.GetIntegratedCosts().GetData();
+    const FIntRect Rect(0, 0, Size, Size);
+
+    TArray<uint8> ScalarDirections;
+    ScalarDirections.SetNumUninitialized(Layout.Num());
+
+    double StartTime = FPlatformTime::Seconds();
+    for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+    {
+        CalculateDirectionsScalar(Costs, ScalarDirections.GetData(), Size, Size, Rect);
+    }
+    const double ScalarMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / Iterations;
+
+#if FLOWFIELD_SSE2_DIRECTIONS
+    TArray<uint8> VectorDirections;
+    VectorDirections.SetNumUninitialized(Layout.Num());
+
+    StartTime = FPlatformTime::Seconds();
+    for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+    {
+        CalculateDirectionsSSE2(Costs, VectorDirections.GetData(), Size, Size, Rect);
+    }
+    const double VectorMs = (FPlatformTime::Seconds() - StartTime) * 1000.0 / Iterations;
+
+    const bool bMatches = ScalarDirections == VectorDirections;
+    UE_LOG(LogTemp, Display, TEXT("Flow field directions %dx%d: scalar %.3f ms, SSE2 %.3f ms (%.1fx), results %s"),
+        Size, Size, ScalarMs, VectorMs, ScalarMs / FMath::Max(VectorMs, 1e-6), bMatches ? TEXT("match") : TEXT("DIFFER"));
+#else
+    UE_LOG(LogTemp, Display, TEXT("Flow field directions %dx%d: scalar %.3f ms (no vector path on this platform)"), Size, Size, ScalarMs);
+#endif
+}
+
+static FAutoConsoleCommand BenchmarkDirectionsCommand(
+    TEXT("FlowField.BenchmarkDirections"),
+    TEXT("Time the scalar and vectorised flow direction passes. Args: [GridSize=512] [Iterations=100]"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&RunDirectionBenchmark));
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Placement of the flow field grid in the world, shared by every field built on it
+struct PROTOTYPE1_API FFlowFieldLayout
+{
+    FVector Origin = FVector::ZeroVector;
+    float CellSize = 100.0f;
+    int32 Width = 0;
+    int32 Height = 0;
+
+    // Where this layout's first cell sits on the full grid; non-zero for sub-layouts
+    FIntPoint GridOffset = FIntPoint::ZeroValue;
+
+    int32 Num() const { return Width * Height; }
+    bool IsValidCell(const FIntPoint& Cell) const { return Cell.X >= 0 && Cell.X < Width && Cell.Y >= 0 && Cell.Y < Height; }
+    int32 CellToIndex(const FIntPoint& Cell) const { return Cell.Y * Width + Cell.X; }
+    FIntPoint IndexToCell(int32 Index) const { return FIntPoint(Index % Width, Index / Width); }
+
+    // World location to the cell containing it (may be outside the grid)
+    FIntPoint WorldToCell(const FVector& WorldLocation) const;
+
+    // Cells whose centres lie inside a world box, max exclusive and not clipped to the grid
+    FIntRect WorldToCellRect(const FBox& WorldBounds) const;
+
+    // Centre of a cell in world space
+    FVector CellToWorld(const FIntPoint& Cell) const;
+
+    // Layout covering just a rectangle of this one, max exclusive
+    FFlowFieldLayout GetSubLayout(const FIntRect& Rect) const;
+
+    bool operator==(const FFlowFieldLayout& Other) const
+    {
+        return Origin.Equals(Other.Origin) && CellSize == Other.CellSize && Width == Other.Width && Height == Other.Height && GridOffset == Other.GridOffset;
+    }
+    bool operator!=(const FFlowFieldLayout& Other) const { return !(*this == Other); }
+};
+
+// Set of grid cells a field flows towards, such as an area to spread a group over or the ground around
+// several buildings. Every cell starts the integration at zero, so each unit heads for whichever goal
+// cell is cheapest for it to reach. Cells are kept sorted and unique so equal goals share a cached field.
+struct PROTOTYPE1_API FFlowFieldGoal
+{
+    // The cell under a world location
+    static FFlowFieldGoal MakePoint(const FFlowFieldLayout& Layout, const FVector& WorldLocation);
+
+    // Cells whose centres lie inside a world box
+    static FFlowFieldGoal MakeBox(const FFlowFieldLayout& Layout, const FBox& WorldBounds);
+
+    // Cells whose centres lie within Radius of Center, ignoring height
+    static FFlowFieldGoal MakeCircle(const FFlowFieldLayout& Layout, const FVector& Center, float Radius);
+
+    // Cells up to RingWidth deep around a footprint, e.g. the ground surrounding a building
+    static FFlowFieldGoal MakeRing(const FFlowFieldLayout& Layout, const FBox& Footprint, int32 RingWidth = 1);
+
+    // Arbitrary grid cells
+    static FFlowFieldGoal MakeCells(const FFlowFieldLayout& Layout, TArrayView<const FIntPoint> InCells);
+
+    // Add another goal's cells, giving a field that leads to the nearest of them
+    void Append(const FFlowFieldGoal& Other);
+
+    bool IsEmpty() const { return Cells.Num() == 0; }
+    const TArray<FIntPoint>& GetCells() const { return Cells; }
+
+    // Goal cell closest to the middle of the set, NoneValue if empty
+    FIntPoint GetAnchorCell() const;
+
+    bool operator==(const FFlowFieldGoal& Other) const { return Hash == Other.Hash && Cells == Other.Cells; }
+    bool operator!=(const FFlowFieldGoal& Other) const { return !(*this == Other); }
+    friend uint32 GetTypeHash(const FFlowFieldGoal& Goal) { return Goal.Hash; }
+
+private:
+    // Sort, drop duplicates and rehash after Cells changes
+    void Normalize();
+
+    TArray<FIntPoint> Cells;
+    uint32 Hash = 0;
+};
+
+// Starting point for an integration pass: a cell index in the field's layout and the cost it starts at
+struct FFlowFieldSeed
+{
+    int32 Index;
+    int32 Cost;
+};
+
+// Cost of stepping into each cell of the full grid, one byte per cell. The subsystem copies it on write rather than
+// editing it in place, so fields and worker threads can keep reading the snapshot they were built with.
+struct PROTOTYPE1_API FFlowFieldCostField
+{
+    static constexpr uint8 Open = 1;
+    static constexpr uint8 Impassable = 255;
+
+    int32 Width = 0;
+    int32 Height = 0;
+    TArray<uint8> Costs;
+
+    void Init(int32 InWidth, int32 InHeight)
+    {
+        Width = InWidth;
+        Height = InHeight;
+        Costs.Init(Open, Width * Height);
+    }
+
+    uint8 GetCost(const FIntPoint& GridCell) const { return Costs[GridCell.Y * Width + GridCell.X]; }
+};
+
+class FFlowField;
+class FFlowFieldSectorGraph;
+
+// Grid cells whose cost changed, along with the state of the world after the change
+struct FFlowFieldChange
+{
+    TSharedPtr<const FFlowFieldCostField> CostField;
+    TSharedPtr<const FFlowFieldSectorGraph> SectorGraph;
+    TArrayView<const FIntPoint> Cells;
+};
+
+// Anything units can steer by, whether one flat field or a hierarchical one built sector by sector
+class PROTOTYPE1_API IFlowField
+{
+public:
+    virtual ~IFlowField() = default;
+
+    // Get flow direction at a world location. Units sample from several threads at once, so this must be safe to.
+    virtual FVector GetFlowDirection(const FVector& WorldLocation) const = 0;
+
+    // Heap memory owned by this field, used for cache budgeting
+    virtual SIZE_T GetAllocatedSize() const = 0;
+
+    // Flat fields that make up this field and have been built so far, for debug drawing
+    virtual void GatherBuiltFields(TArray<const FFlowField*>& OutFields) const = 0;
+
+    // Bring the field up to date after cell costs changed, touching only what the change reaches.
+    // Returns false if the target itself is now blocked and the field should be thrown away.
+    virtual bool ApplyChange(const FFlowFieldChange& Change) = 0;
+};
+
+// Integration costs and flow directions towards a target cell or a goal area.
+// Built once and then treated as read-only, so the same field can be shared by every unit heading to that cell.
+// The only later writes are repairs applied on the game thread when grid cells change.
+// Stored as two parallel arrays, three bytes per cell, so a whole field stays small enough to keep many cached.
+class PROTOTYPE1_API FFlowField : public IFlowField
+{
+public:
+    // Integrated costs saturate at MaxIntegratedCost; UnreachedCost marks cells no seed can reach
+    static constexpr uint16 UnreachedCost = MAX_uint16;
+    static constexpr uint16 MaxIntegratedCost = MAX_uint16 - 1;
+
+    // Directions are packed into a byte: 0-7 are the compass directions counter-clockwise from +X
+    static constexpr uint8 NoDirection = 0xFF;
+    static FVector2f DecodeDirection(uint8 Direction);
+
+    // Without a cost field every cell costs FFlowFieldCostField::Open to enter
+    FFlowField(const FFlowFieldLayout& InLayout, const FIntPoint& InTargetCell, TSharedPtr<const FFlowFieldCostField> InCostField = nullptr);
+
+    // Run the integration pass from the target cell and derive flow directions
+    void Build();
+
+    // Run the integration pass from arbitrary seeds instead of the target cell
+    void Build(TArrayView<const FFlowFieldSeed> Seeds);
+
+    // Run the integration pass from every goal cell that falls inside this field's layout
+    void Build(const FFlowFieldGoal& Goal);
+
+    // IFlowField
+    virtual FVector GetFlowDirection(const FVector& WorldLocation) const override;
+    virtual SIZE_T GetAllocatedSize() const override;
+    virtual void GatherBuiltFields(TArray<const FFlowField*>& OutFields) const override;
+    virtual bool ApplyChange(const FFlowFieldChange& Change) override;
+
+    // Swap in a new cost field snapshot and fix up costs and directions around the cells that
+    // differ from the old one. Cells whose route ran through a cell that got dearer are re-propagated
+    // from the intact rim of the hole they leave, cheaper cells are lowered by a wave from their
+    // neighbours, and nothing outside those two regions is visited. Returns false if every seed is now impassable.
+    bool Repair(TSharedPtr<const FFlowFieldCostField> NewCostField, TArrayView<const FIntPoint> ChangedGridCells);
+
+    const FFlowFieldLayout& GetLayout() const { return Layout; }
+    const FIntPoint& GetTargetCell() const { return TargetCell; }
+    // Bumped whenever costs or directions change, so a field repaired in place can be told apart from before
+    uint32 GetRevision() const { return Revision; }
+
+    const TArray<uint16>& GetIntegratedCosts() const { return IntegratedCosts; }
+    const TArray<uint8>& GetDirections() const { return Directions; }
+
+    // Integrated cost of a cell, MAX_int32 if it was never reached
+    int32 GetIntegratedCost(const FIntPoint& Cell) const;
+
+private:
+    // Largest step cost CalculateCost can return; sizes the bucket ring used by PropagateCosts
+    static constexpr int32 MaxStepCost = FFlowFieldCostField::Impassable - 1;
+
+    void PropagateCosts(TArrayView<const FFlowFieldSeed> Seeds);
+    void CalculateFlowDirections();
+
+    // Recompute directions for the cells in Rect only, max exclusive
+    void CalculateFlowDirections(const FIntRect& Rect);
+
+    // Cost calculation helpers
+    int32 CalculateCost(const FIntPoint& From, const FIntPoint& To) const;
+    static uint8 GetStepCost(const FFlowFieldCostField* InCostField, const FIntPoint& GridCell) { return InCostField ? InCostField->GetCost(GridCell) : FFlowFieldCostField::Open; }
+    bool IsBlocked(const FIntPoint& Cell) const { return GetStepCost(CostField.Get(), Cell + Layout.GridOffset) == FFlowFieldCostField::Impassable; }
+
+    FFlowFieldLayout Layout;
+    FIntPoint TargetCell;
+    TSharedPtr<const FFlowFieldCostField> CostField;
+    TArray<uint16> IntegratedCosts;
+    TArray<uint8> Directions;
+    uint32 Revision = 0;
+
+    // What the last build started from, kept so repairs can restore seed cells that come free again.
+    // Sorted by index so large goal areas can be searched rather than scanned.
+    TArray<FFlowFieldSeed> BuildSeeds;
+};
@@ -0,0 +1,391 @@
+#include "FlowFieldSubsystem.h"
+#include "Async/Async.h"
+#include "Tasks/Task.h"
+
+UFlowFieldSubsystem::UFlowFieldSubsystem()
+{
+    CacheBudgetMB = 32;
+    bUseHierarchicalFlowFields = false;
+    SectorSize = 32;
+    bGridConfigured = false;
+    NextRequestId = 0;
+    UseCounter = 0;
+    CachedBytes = 0;
+}
+
+void UFlowFieldSubsystem::Deinitialize()
+{
+    CancelPendingBuilds();
+    FlushCache();
+    Super::Deinitialize();
+}
+
+void UFlowFieldSubsystem::Tick(float DeltaTime)
+{
+    Super::Tick(DeltaTime);
+    FlushDirtyCells();
+}
+
+TStatId UFlowFieldSubsystem::GetStatId() const
+{
+    RETURN_QUICK_DECLARE_CYCLE_STAT(UFlowFieldSubsystem, STATGROUP_Tickables);
+}
+
+void UFlowFieldSubsystem::ConfigureGrid(const FVector& Origin, const FVector& WorldSize, float CellSize)
+{
+    FFlowFieldLayout NewLayout;
+    NewLayout.Origin = Origin;
+    NewLayout.CellSize = CellSize;
+    NewLayout.Width = FMath::CeilToInt(WorldSize.X / CellSize);
+    NewLayout.Height = FMath::CeilToInt(WorldSize.Y / CellSize);
+
+    if (bGridConfigured && NewLayout == Layout)
+        return;
+
+    // Cached fields, builds in flight and the sector graph are all laid out on the old grid
+    CancelPendingBuilds();
+    FlushCache();
+    SectorGraph.Reset();
+    Layout = NewLayout;
+    bGridConfigured = true;
+
+    CostField = MakeShared<FFlowFieldCostField>();
+    CostField->Init(Layout.Width, Layout.Height);
+    DirtyCells.Reset();
+
+    // Built with the grid so no request pays for it. Sectors are linked as searches reach them, so this only cuts portals.
+    if (bUseHierarchicalFlowFields)
+    {
+        TSharedRef<FFlowFieldSectorGraph> NewGraph = MakeShared<FFlowFieldSectorGraph>();
+        NewGraph->Build(Layout, SectorSize, CostField);
+        SectorGraph = NewGraph;
+    }
+}
+
+void UFlowFieldSubsystem::SetAreaCost(const FBox& WorldBounds, uint8 Cost)
+{
+    if (!bGridConfigured)
+        return;
+
+    // Cells whose centres fall inside the bounds
+    FIntRect Rect = Layout.WorldToCellRect(WorldBounds);
+    Rect.Clip(FIntRect(0, 0, Layout.Width, Layout.Height));
+
+    for (int32 Y = Rect.Min.Y; Y < Rect.Max.Y; ++Y)
+    {
+        for (int32 X = Rect.Min.X; X < Rect.Max.X; ++X)
+        {
+            const int32 Index = Layout.CellToIndex(FIntPoint(X, Y));
+            if (CostField->Costs[Index] == Cost)
+                continue;
+
+            // Cached fields and worker threads may still be reading the current snapshot
+            if (!CostField.IsUnique())
+            {
+                CostField = MakeShared<FFlowFieldCostField>(*CostField);
+            }
+
+            CostField->Costs[Index] = Cost;
+            DirtyCells.Add(FIntPoint(X, Y));
+        }
+    }
+}
+
+void UFlowFieldSubsystem::FlushDirtyCells()
+{
+    if (DirtyCells.Num() == 0)
+        return;
+
+    const TArray<FIntPoint> ChangedCells = MoveTemp(DirtyCells);
+    DirtyCells.Reset();
+
+    // The graph is shared with fields and workers too, so it is rebuilt on a copy
+    if (SectorGraph)
+    {
+        TSharedRef<FFlowFieldSectorGraph> NewGraph = MakeShared<FFlowFieldSectorGraph>(*SectorGraph);
+        NewGraph->Rebuild(CostField, ChangedCells);
+        SectorGraph = NewGraph;
+    }
+
+    // Builds in flight read an older snapshot and catch up with these when they finish
+    for (TPair<FFlowFieldGoal, FPendingFlowFieldBuild>& Pair : PendingBuilds)
+    {
+        Pair.Value.ChangedCells.Append(ChangedCells);
+    }
+
+    FFlowFieldChange Change;
+    Change.CostField = CostField;
+    Change.SectorGraph = SectorGraph;
+    Change.Cells = ChangedCells;
+
+    for (auto It = Cache.CreateIterator(); It; ++It)
+    {
+        FCachedFlowField& Cached = It.Value();
+        if (!Cached.Field->ApplyChange(Change))
+        {
+            // The target was walled in; units already holding the field keep it until they ask again
+            CachedBytes -= Cached.AllocatedSize;
+            It.RemoveCurrent();
+            continue;
+        }
+
+        const SIZE_T AllocatedSize = Cached.Field->GetAllocatedSize();
+        CachedBytes += int64(AllocatedSize) - int64(Cached.AllocatedSize);
+        Cached.AllocatedSize = AllocatedSize;
+    }
+}
+
+TSharedPtr<const IFlowField> UFlowFieldSubsystem::FindOrBuildFlowField(const FVector& TargetLocation)
+{
+    return FindOrBuildFlowField(FFlowFieldGoal::MakePoint(Layout, TargetLocation));
+}
+
+TSharedPtr<const IFlowField> UFlowFieldSubsystem::FindOrBuildFlowField(const FFlowFieldGoal& Goal)
+{
+    if (!bGridConfigured || !IsValidGoal(Goal))
+        return nullptr;
+
+    FlushDirtyCells();
+
+    if (TSharedPtr<const IFlowField> Cached = FindCachedFlowField(Goal))
+        return Cached;
+
+    ++Stats.Misses;
+
+    TSharedRef<IFlowField> NewField = BuildFlowField(Layout, CostField, SectorGraph, Goal);
+    AddToCache(Goal, NewField);
+    return NewField;
+}
+
+uint64 UFlowFieldSubsystem::RequestFlowField(const FVector& TargetLocation, FOnFlowFieldReady OnReady)
+{
+    return RequestFlowField(FFlowFieldGoal::MakePoint(Layout, TargetLocation), MoveTemp(OnReady));
+}
+
+uint64 UFlowFieldSubsystem::RequestFlowField(const FFlowFieldGoal& Goal, FOnFlowFieldReady OnReady)
+{
+    if (!bGridConfigured || !IsValidGoal(Goal))
+    {
+        OnReady.ExecuteIfBound(nullptr);
+        return 0;
+    }
+
+    FlushDirtyCells();
+
+    if (TSharedPtr<const IFlowField> Cached = FindCachedFlowField(Goal))
+    {
+        OnReady.ExecuteIfBound(Cached);
+        return 0;
+    }
+
+    const uint64 RequestId = ++NextRequestId;
+
+    // Someone already asked for this goal, so wait on their build
+    if (FPendingFlowFieldBuild* Pending = PendingBuilds.Find(Goal))
+    {
+        Pending->Waiters.Emplace(RequestId, MoveTemp(OnReady));
+        return RequestId;
+    }
+
+    ++Stats.Misses;
+
+    FPendingFlowFieldBuild& NewBuild = PendingBuilds.Add(Goal);
+    NewBuild.Waiters.Emplace(RequestId, MoveTemp(OnReady));
+    LaunchFlowFieldBuild(Goal, NewBuild);
+
+    return RequestId;
+}
+
+void UFlowFieldSubsystem::LaunchFlowFieldBuild(const FFlowFieldGoal& Goal, FPendingFlowFieldBuild& Pending)
+{
+    // The worker only reads the sector graph, which already exists with the grid; any sector links the search still
+    // needs are measured on the worker
+    TSharedPtr<const FFlowFieldSectorGraph> Graph = SectorGraph;
+
+    // The worker gets copies of everything it needs and never touches the subsystem
+    UE::Tasks::Launch(UE_SOURCE_LOCATION,
+        [WeakThis = TWeakObjectPtr<UFlowFieldSubsystem>(this), BuildLayout = Layout, Costs = TSharedPtr<const FFlowFieldCostField>(CostField), Graph, Goal, bCancelled = Pending.bCancelled]()
+        {
+            if (*bCancelled)
+                return;
+
+            TSharedRef<IFlowField> NewField = BuildFlowField(BuildLayout, Costs, Graph, Goal);
+
+            AsyncTask(ENamedThreads::GameThread, [WeakThis, Goal, bCancelled, Costs, NewField]()
+            {
+                if (UFlowFieldSubsystem* Subsystem = WeakThis.Get())
+                {
+                    Subsystem->CompleteFlowFieldBuild(Goal, bCancelled, Costs, NewField);
+                }
+            });
+        });
+}
+
+void UFlowFieldSubsystem::CancelFlowFieldRequest(uint64 RequestId)
+{
+    if (RequestId == 0)
+        return;
+
+    for (auto It = PendingBuilds.CreateIterator(); It; ++It)
+    {
+        FPendingFlowFieldBuild& Pending = It.Value();
+        const int32 NumRemoved = Pending.Waiters.RemoveAll([RequestId](const TPair<uint64, FOnFlowFieldReady>& Waiter) { return Waiter.Key == RequestId; });
+        if (NumRemoved == 0)
+            continue;
+
+        if (Pending.Waiters.Num() == 0)
+        {
+            *Pending.bCancelled = true;
+            It.RemoveCurrent();
+        }
+        return;
+    }
+}
+
+void UFlowFieldSubsystem::CompleteFlowFieldBuild(const FFlowFieldGoal& Goal, const TSharedRef<std::atomic<bool>>& bCancelled,
+    const TSharedPtr<const FFlowFieldCostField>& BuiltWithCostField, TSharedRef<IFlowField> Field)
+{
+    // A cancelled build has already been removed, and a newer one for the same goal would carry its own flag
+    FPendingFlowFieldBuild* Pending = PendingBuilds.Find(Goal);
+    if (!Pending || Pending->bCancelled != bCancelled)
+        return;
+
+    // Cells changed while the worker was busy. The snapshot it read is never written to, so a different
+    // pointer means the field is out of date; repair it like a cached field rather than building again.
+    FlushDirtyCells();
+    TSharedPtr<IFlowField> ReadyField = Field;
+    if (BuiltWithCostField != CostField)
+    {
+        FFlowFieldChange Change;
+        Change.CostField = CostField;
+        Change.SectorGraph = SectorGraph;
+        Change.Cells = Pending->ChangedCells;
+        if (!Field->ApplyChange(Change))
+        {
+            ReadyField.Reset();
+        }
+    }
+
+    // Waiters may issue new requests from their callbacks, so take them out of the map first
+    TArray<TPair<uint64, FOnFlowFieldReady>> Waiters = MoveTemp(Pending->Waiters);
+    PendingBuilds.Remove(Goal);
+
+    if (ReadyField)
+    {
+        AddToCache(Goal, ReadyField.ToSharedRef());
+    }
+
+    for (TPair<uint64, FOnFlowFieldReady>& Waiter : Waiters)
+    {
+        Waiter.Value.ExecuteIfBound(ReadyField);
+    }
+}
+
+void UFlowFieldSubsystem::CancelPendingBuilds()
+{
+    TMap<FFlowFieldGoal, FPendingFlowFieldBuild> CancelledBuilds = MoveTemp(PendingBuilds);
+    PendingBuilds.Reset();
+
+    for (TPair<FFlowFieldGoal, FPendingFlowFieldBuild>& Pair : CancelledBuilds)
+    {
+        *Pair.Value.bCancelled = true;
+
+        // Let waiters know they won't get a field so they can ask again
+        for (TPair<uint64, FOnFlowFieldReady>& Waiter : Pair.Value.Waiters)
+        {
+            Waiter.Value.ExecuteIfBound(nullptr);
+        }
+    }
+}
+
+TSharedRef<IFlowField> UFlowFieldSubsystem::BuildFlowField(const FFlowFieldLayout& InLayout, TSharedPtr<const FFlowFieldCostField> InCostField,
+    TSharedPtr<const FFlowFieldSectorGraph> InSectorGraph, const FFlowFieldGoal& Goal)
+{
+    if (InSectorGraph)
+    {
+        TSharedRef<FSectorFlowField> SectorField = MakeShared<FSectorFlowField>(InSectorGraph.ToSharedRef(), Goal);
+        SectorField->Build();
+        return SectorField;
+    }
+
+    TSharedRef<FFlowField> FlatField = MakeShared<FFlowField>(InLayout, Goal.GetAnchorCell(), InCostField);
+    FlatField->Build(Goal);
+    return FlatField;
+}
+
+bool UFlowFieldSubsystem::IsValidGoal(const FFlowFieldGoal& Goal) const
+{
+    return !Goal.IsEmpty() && !Goal.GetCells().ContainsByPredicate([this](const FIntPoint& Cell) { return !Layout.IsValidCell(Cell); });
+}
+
+TSharedPtr<const IFlowField> UFlowFieldSubsystem::FindCachedFlowField(const FFlowFieldGoal& Goal)
+{
+    FCachedFlowField* Cached = Cache.Find(Goal);
+    if (!Cached)
+        return nullptr;
+
+    ++Stats.Hits;
+    Cached->LastUsed = ++UseCounter;
+
+    // Hierarchical fields grow as units reach new sectors
+    const SIZE_T AllocatedSize = Cached->Field->GetAllocatedSize();
+    CachedBytes += int64(AllocatedSize) - int64(Cached->AllocatedSize);
+    Cached->AllocatedSize = AllocatedSize;
+    return Cached->Field;
+}
+
+void UFlowFieldSubsystem::AddToCache(const FFlowFieldGoal& Goal, const TSharedRef<IFlowField>& Field)
+{
+    if (const FCachedFlowField* Existing = Cache.Find(Goal))
+    {
+        CachedBytes -= Existing->AllocatedSize;
+    }
+
+    FCachedFlowField& Entry = Cache.Add(Goal);
+    Entry.Field = Field;
+    Entry.AllocatedSize = Field->GetAllocatedSize();
+    Entry.LastUsed = ++UseCounter;
+    CachedBytes += Entry.AllocatedSize;
+
+    EvictToBudget();
+}
+
+void UFlowFieldSubsystem::EvictToBudget()
+{
+    const int64 BudgetBytes = int64(CacheBudgetMB) * 1024 * 1024;
+
+    // Fields are large and few, so a linear scan for the oldest entry is cheaper than keeping a list.
+    // The most recent field is always kept, even if it alone exceeds the budget.
+    while (CachedBytes > BudgetBytes && Cache.Num() > 1)
+    {
+        const FFlowFieldGoal* OldestKey = nullptr;
+        uint64 OldestUse = MAX_uint64;
+        for (const TPair<FFlowFieldGoal, FCachedFlowField>& Pair : Cache)
+        {
+            if (Pair.Value.LastUsed < OldestUse)
+            {
+                OldestUse = Pair.Value.LastUsed;
+                OldestKey = &Pair.Key;
+            }
+        }
+
+        const FFlowFieldGoal EvictedKey = *OldestKey;
+        CachedBytes -= Cache[EvictedKey].AllocatedSize;
+        Cache.Remove(EvictedKey);
+        ++Stats.Evictions;
+    }
+}
+
+void UFlowFieldSubsystem::FlushCache()
+{
+    Cache.Empty();
+    CachedBytes = 0;
+}
+
+FFlowFieldCacheStats UFlowFieldSubsystem::GetCacheStats() const
+{
+    FFlowFieldCacheStats Result = Stats;
+    Result.NumCachedFields = Cache.Num();
+    Result.CachedBytes = CachedBytes;
+    return Result;
+}
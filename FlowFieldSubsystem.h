@@ -0,0 +1,149 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FlowField.h"
+#include "SectorFlowField.h"
+#include <atomic>
+#include "FlowFieldSubsystem.generated.h"
+
+// Called on the game thread when an asynchronous flow field request finishes.
+// The field is null if the target was off the grid or was walled in while the field was being built.
+DECLARE_DELEGATE_OneParam(FOnFlowFieldReady, TSharedPtr<const IFlowField>);
+
+USTRUCT(BlueprintType)
+struct FFlowFieldCacheStats
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadOnly, Category = "Flow Field")
+    int32 Hits = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Flow Field")
+    int32 Misses = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Flow Field")
+    int32 Evictions = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Flow Field")
+    int32 NumCachedFields = 0;
+
+    UPROPERTY(BlueprintReadOnly, Category = "Flow Field")
+    int64 CachedBytes = 0;
+};
+
+// World-level flow field service. Finished fields are cached by goal and the same
+// read-only field is handed to every unit heading to that goal.
+// Cell costs changed during a frame are batched and repaired into the cached fields on the next tick.
+UCLASS(config=Game)
+class PROTOTYPE1_API UFlowFieldSubsystem : public UTickableWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    UFlowFieldSubsystem();
+
+    virtual void Deinitialize() override;
+    virtual void Tick(float DeltaTime) override;
+    virtual TStatId GetStatId() const override;
+
+    // Set the grid every field is built on. Changing it drops all cached fields.
+    void ConfigureGrid(const FVector& Origin, const FVector& WorldSize, float CellSize);
+    bool IsGridConfigured() const { return bGridConfigured; }
+    const FFlowFieldLayout& GetLayout() const { return Layout; }
+
+    // Set the cost of stepping into the cells whose centres lie inside WorldBounds; FFlowFieldCostField::Impassable blocks them.
+    // Cached fields are repaired around the change rather than rebuilt, and fields it never reaches are left as they are.
+    void SetAreaCost(const FBox& WorldBounds, uint8 Cost);
+
+    // Get the field flowing to the nearest cell of Goal, building it on a cache miss.
+    // Returns a hierarchical field when bUseHierarchicalFlowFields is set, null if the goal is empty or off the grid.
+    TSharedPtr<const IFlowField> FindOrBuildFlowField(const FFlowFieldGoal& Goal);
+    TSharedPtr<const IFlowField> FindOrBuildFlowField(const FVector& TargetLocation);
+
+    // Build the field for Goal on a worker thread and hand it to OnReady on the game thread.
+    // Cache hits complete immediately and return 0; otherwise returns an id for CancelFlowFieldRequest.
+    // Requests for the same goal share one build.
+    uint64 RequestFlowField(const FFlowFieldGoal& Goal, FOnFlowFieldReady OnReady);
+    uint64 RequestFlowField(const FVector& TargetLocation, FOnFlowFieldReady OnReady);
+
+    // Drop a pending request. The build itself is abandoned once nobody else is waiting on it.
+    void CancelFlowFieldRequest(uint64 RequestId);
+
+    // Drop every cached field. Units still holding a field keep it alive until they let go.
+    void FlushCache();
+
+    UFUNCTION(BlueprintCallable, Category = "Flow Field")
+    FFlowFieldCacheStats GetCacheStats() const;
+
+    // Current cell costs, null until the grid is configured. The snapshot is never written once handed out, so it can be
+    // read from any thread; fetch it again to see later changes, and let go of it soon to spare the next change a copy.
+    TSharedPtr<const FFlowFieldCostField> GetCostField() const { return bGridConfigured ? CostField : nullptr; }
+
+protected:
+    // Memory cap for cached fields; least recently used fields are evicted above it
+    UPROPERTY(Config)
+    int32 CacheBudgetMB;
+
+    // Build fields sector by sector along portal corridors instead of over the whole grid
+    UPROPERTY(Config)
+    bool bUseHierarchicalFlowFields;
+
+    // Width and height of a sector in cells when building hierarchical fields
+    UPROPERTY(Config)
+    int32 SectorSize;
+
+private:
+    struct FCachedFlowField
+    {
+        TSharedPtr<IFlowField> Field;
+        SIZE_T AllocatedSize = 0;
+        uint64 LastUsed = 0;
+    };
+
+    // Requests waiting on the same background build
+    struct FPendingFlowFieldBuild
+    {
+        TSharedRef<std::atomic<bool>> bCancelled = MakeShared<std::atomic<bool>>(false);
+        TArray<TPair<uint64, FOnFlowFieldReady>> Waiters;
+
+        // Cells flushed since the build took its cost field snapshot, repaired into the field when it lands
+        TArray<FIntPoint> ChangedCells;
+    };
+
+    // Build a field from scratch; safe to call from any thread
+    static TSharedRef<IFlowField> BuildFlowField(const FFlowFieldLayout& InLayout, TSharedPtr<const FFlowFieldCostField> InCostField,
+        TSharedPtr<const FFlowFieldSectorGraph> InSectorGraph, const FFlowFieldGoal& Goal);
+
+    // Goals are made against a layout, so one from before the grid was reconfigured may not fit it
+    bool IsValidGoal(const FFlowFieldGoal& Goal) const;
+
+    TSharedPtr<const IFlowField> FindCachedFlowField(const FFlowFieldGoal& Goal);
+    void AddToCache(const FFlowFieldGoal& Goal, const TSharedRef<IFlowField>& Field);
+    void LaunchFlowFieldBuild(const FFlowFieldGoal& Goal, FPendingFlowFieldBuild& Pending);
+    void CompleteFlowFieldBuild(const FFlowFieldGoal& Goal, const TSharedRef<std::atomic<bool>>& bCancelled,
+        const TSharedPtr<const FFlowFieldCostField>& BuiltWithCostField, TSharedRef<IFlowField> Field);
+    void CancelPendingBuilds();
+    void EvictToBudget();
+
+    // Repair cached fields and the sector graph for every cell changed since the last flush
+    void FlushDirtyCells();
+
+    FFlowFieldLayout Layout;
+    bool bGridConfigured;
+
+    // Portal graph for hierarchical fields, built with the grid; null when they're off
+    TSharedPtr<const FFlowFieldSectorGraph> SectorGraph;
+
+    // Current cell costs. Replaced with a copy before writing whenever anything else holds it.
+    TSharedPtr<FFlowFieldCostField> CostField;
+    TArray<FIntPoint> DirtyCells;
+
+    TMap<FFlowFieldGoal, FCachedFlowField> Cache;
+    TMap<FFlowFieldGoal, FPendingFlowFieldBuild> PendingBuilds;
+    uint64 NextRequestId;
+    uint64 UseCounter;
+    int64 CachedBytes;
+
+    FFlowFieldCacheStats Stats;
+};
@@ -1,6 +1,16 @@
 #include "FlowFieldSystem.h"
-#include "DrawDebugHelpers.h"
-#include "NavigationSystem.h"
+#include "FlowFieldSubsystem.h"
+#include "ConvexVolume.h"
+#include "SceneView.h"
+#include "Engine/LocalPlayer.h"
+#include "Engine/GameViewportClient.h"
+
+static TAutoConsoleVariable<int32> CVarFlowFieldDebugDraw(
+    TEXT("FlowField.DebugDraw"),
+    0,
+    TEXT("Draw flow field directions and cell outlines for every AFlowFieldSystem.\n")
+    TEXT("0: off (default)\n")
+    TEXT("1: on"));
 
 AFlowFieldSystem::AFlowFieldSystem()
 {
@@ -9,6 +19,12 @@ AFlowFieldSystem::AFlowFieldSystem()
     // Default values with larger world size
     WorldSize = FVector(5000.0f, 5000.0f, 0.0f);
     CellSize = 100.0f;
+    bAsyncUpdates = true;
+
+    PendingRequestId = 0;
+
+    DebugLines = nullptr;
+    DebugFieldSignature = 0;
 }
 
 void AFlowFieldSystem::BeginPlay()
@@ -17,10 +33,16 @@ void AFlowFieldSystem::BeginPlay()
     InitializeFlowField(WorldSize, CellSize);
 }
 
+void AFlowFieldSystem::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    CancelPendingUpdate();
+    Super::EndPlay(EndPlayReason);
+}
+
 void AFlowFieldSystem::Tick(float DeltaTime)
 {
     Super::Tick(DeltaTime);
-    DrawDebugFlowField();
+    UpdateDebugDraw();
 }
 
 void AFlowFieldSystem::InitializeFlowField(const FVector& InWorldSize, float InCellSize)
@@ -28,202 +50,223 @@ void AFlowFieldSystem::InitializeFlowField(const FVector& InWorldSize, float InC
     WorldSize = InWorldSize;
     CellSize = InCellSize;
 
-    // Calculate grid dimensions
-    GridWidth = FMath::CeilToInt(WorldSize.X / CellSize);
-    GridHeight = FMath::CeilToInt(WorldSize.Y / CellSize);
+    // The grid is shared by every flow field in the world, so only the first system to start lays it out
+    UFlowFieldSubsystem* FlowFieldSubsystem = GetWorld()->GetSubsystem<UFlowFieldSubsystem>();
+    if (FlowFieldSubsystem && !FlowFieldSubsystem->IsGridConfigured())
+    {
+        FlowFieldSubsystem->ConfigureGrid(GetActorLocation(), WorldSize, CellSize);
+    }
+}
 
-    // Initialize the grid
-    FlowFieldGrid.SetNum(GridWidth * GridHeight);
+void AFlowFieldSystem::UpdateFlowField(const FVector& TargetLocation)
+{
+    if (UFlowFieldSubsystem* FlowFieldSubsystem = GetWorld()->GetSubsystem<UFlowFieldSubsystem>())
+    {
+        UpdateFlowField(FFlowFieldGoal::MakePoint(FlowFieldSubsystem->GetLayout(), TargetLocation));
+    }
 }
 
-FVector2D AFlowFieldSystem::WorldToGrid(const FVector& WorldLocation) const
+void AFlowFieldSystem::UpdateFlowField(const FFlowFieldGoal& Goal)
 {
-    FVector LocalLocation = WorldLocation - GetActorLocation();
-    return FVector2D(
-        FMath::FloorToInt(LocalLocation.X / CellSize),
-        FMath::FloorToInt(LocalLocation.Y / CellSize)
-    );
+    UFlowFieldSubsystem* FlowFieldSubsystem = GetWorld()->GetSubsystem<UFlowFieldSubsystem>();
+    if (!FlowFieldSubsystem)
+        return;
+
+    if (!bAsyncUpdates)
+    {
+        FlowField = FlowFieldSubsystem->FindOrBuildFlowField(Goal);
+        OnFlowFieldUpdated.Broadcast(this);
+        return;
+    }
+
+    // Already building this goal; restarting would only throw the work away
+    if (IsUpdatePending() && Goal == PendingGoal)
+        return;
+
+    // A new goal supersedes whatever was still building
+    CancelPendingUpdate();
+
+    // Cache hits call straight back and return 0
+    PendingGoal = Goal;
+    PendingRequestId = FlowFieldSubsystem->RequestFlowField(Goal, FOnFlowFieldReady::CreateUObject(this, &AFlowFieldSystem::OnFlowFieldReady));
 }
 
-FVector AFlowFieldSystem::GridToWorld(const FVector2D& GridLocation) const
+void AFlowFieldSystem::CancelPendingUpdate()
 {
-    return GetActorLocation() + FVector(
-        GridLocation.X * CellSize + CellSize * 0.5f,
-        GridLocation.Y * CellSize + CellSize * 0.5f,
-        0.0f
-    );
+    if (!IsUpdatePending())
+        return;
+
+    if (UFlowFieldSubsystem* FlowFieldSubsystem = GetWorld()->GetSubsystem<UFlowFieldSubsystem>())
+    {
+        FlowFieldSubsystem->CancelFlowFieldRequest(PendingRequestId);
+    }
+    PendingRequestId = 0;
+    PendingGoal = FFlowFieldGoal();
 }
 
-int32 AFlowFieldSystem::GridToIndex(const FVector2D& GridLocation) const
+void AFlowFieldSystem::OnFlowFieldReady(TSharedPtr<const IFlowField> NewField)
 {
-    return GridLocation.Y * GridWidth + GridLocation.X;
+    PendingRequestId = 0;
+    PendingGoal = FFlowFieldGoal();
+
+    // Swap the finished back buffer in; GetFlowDirection has been serving the old one until now
+    const bool bChanged = NewField != FlowField;
+    FlowField = MoveTemp(NewField);
+
+    if (bChanged)
+    {
+        OnFlowFieldUpdated.Broadcast(this);
+    }
 }
 
-bool AFlowFieldSystem::IsValidGridLocation(const FVector2D& GridLocation) const
+FVector AFlowFieldSystem::GetFlowDirection(const FVector& WorldLocation) const
 {
-    return GridLocation.X >= 0 && GridLocation.X < GridWidth &&
-           GridLocation.Y >= 0 && GridLocation.Y < GridHeight;
+    if (!FlowField)
+        return FVector::ZeroVector;
+
+    return FlowField->GetFlowDirection(WorldLocation);
 }
 
-void AFlowFieldSystem::UpdateFlowField(const FVector& TargetLocation)
+bool AFlowFieldSystem::IsDebugDrawEnabled()
 {
-    CalculateFlowField(TargetLocation);
+    return CVarFlowFieldDebugDraw.GetValueOnGameThread() != 0;
 }
 
-void AFlowFieldSystem::CalculateFlowField(const FVector& TargetLocation)
+void AFlowFieldSystem::UpdateDebugDraw()
 {
-    // Reset all cells
-    for (auto& Cell : FlowFieldGrid)
+    if (!IsDebugDrawEnabled() || !FlowField)
     {
-        Cell.Cost = FLT_MAX;
-        Cell.FlowDirection = FVector2D::ZeroVector;
-    }
-
-    // Convert target to grid coordinates
-    FVector2D TargetGridLocation = WorldToGrid(TargetLocation);
-    if (!IsValidGridLocation(TargetGridLocation))
+        if (DebugLines && SubmittedDebugChunks.Num() > 0)
+        {
+            DebugLines->Flush();
+        }
+        DebugChunks.Reset();
+        SubmittedDebugChunks.Reset();
+        DebugFieldSignature = 0;
         return;
+    }
 
-    // Set target cell cost to 0
-    FlowFieldGrid[GridToIndex(TargetGridLocation)].Cost = 0.0f;
-
-    // Propagate costs from target
-    PropagateCosts(TargetGridLocation);
+    // Repairs change fields in place and hierarchical fields grow a sector at a time, so watch every built piece
+    TArray<const FFlowField*> BuiltFields;
+    FlowField->GatherBuiltFields(BuiltFields);
 
-    // Calculate flow directions
-    CalculateFlowDirections();
-}
-
-void AFlowFieldSystem::PropagateCosts(const FVector2D& TargetGridLocation)
-{
-    TArray<FVector2D> OpenSet;
-    OpenSet.Add(TargetGridLocation);
+    uint32 Signature = 0;
+    for (const FFlowField* Field : BuiltFields)
+    {
+        Signature = HashCombine(Signature, HashCombine(GetTypeHash(Field), Field->GetRevision()));
+    }
 
-    while (!OpenSet.IsEmpty())
+    const bool bRebuild = Signature != DebugFieldSignature || DebugChunks.Num() == 0;
+    if (bRebuild)
     {
-        FVector2D Current = OpenSet.Pop(false);
-        TArray<FVector2D> Neighbors = GetNeighbors(Current);
+        BuildDebugChunks(BuiltFields);
+        DebugFieldSignature = Signature;
+    }
 
-        for (const FVector2D& Neighbor : Neighbors)
-        {
-            if (!IsValidGridLocation(Neighbor))
-                continue;
+    TBitArray<> VisibleChunks = GetVisibleDebugChunks();
+    if (!bRebuild && VisibleChunks == SubmittedDebugChunks)
+        return;
 
-            float NewCost = FlowFieldGrid[GridToIndex(Current)].Cost + CalculateCost(Current, Neighbor);
-            int32 NeighborIndex = GridToIndex(Neighbor);
+    if (!DebugLines)
+    {
+        DebugLines = NewObject<ULineBatchComponent>(this, TEXT("FlowFieldDebugLines"));
+        DebugLines->RegisterComponent();
+    }
 
-            if (NewCost < FlowFieldGrid[NeighborIndex].Cost)
-            {
-                FlowFieldGrid[NeighborIndex].Cost = NewCost;
-                OpenSet.Add(Neighbor);
-            }
-        }
+    TArray<FBatchedLine> Lines;
+    for (TConstSetBitIterator<> It(VisibleChunks); It; ++It)
+    {
+        Lines.Append(DebugChunks[It.GetIndex()].Lines);
     }
+
+    // Lines with no lifetime stay until the next flush
+    DebugLines->Flush();
+    DebugLines->DrawLines(Lines);
+    SubmittedDebugChunks = MoveTemp(VisibleChunks);
 }
 
-void AFlowFieldSystem::CalculateFlowDirections()
+void AFlowFieldSystem::BuildDebugChunks(const TArray<const FFlowField*>& Fields)
 {
-    for (int32 Y = 0; Y < GridHeight; ++Y)
+    constexpr int32 ChunkSize = 16;
+    constexpr float ArrowSize = 20.0f;
+
+    DebugChunks.Reset();
+
+    for (const FFlowField* Field : Fields)
     {
-        for (int32 X = 0; X < GridWidth; ++X)
-        {
-            FVector2D Current(X, Y);
-            TArray<FVector2D> Neighbors = GetNeighbors(Current);
-            FVector2D LowestCostNeighbor = Current;
-            float LowestCost = FlowFieldGrid[GridToIndex(Current)].Cost;
+        const FFlowFieldLayout& Layout = Field->GetLayout();
+        const TArray<uint8>& Directions = Field->GetDirections();
+        const float Size = Layout.CellSize;
 
-            for (const FVector2D& Neighbor : Neighbors)
+        for (int32 ChunkY = 0; ChunkY < Layout.Height; ChunkY += ChunkSize)
+        {
+            for (int32 ChunkX = 0; ChunkX < Layout.Width; ChunkX += ChunkSize)
             {
-                if (!IsValidGridLocation(Neighbor))
-                    continue;
+                const FIntRect Rect(ChunkX, ChunkY, FMath::Min(ChunkX + ChunkSize, Layout.Width), FMath::Min(ChunkY + ChunkSize, Layout.Height));
+                const FVector Min = Layout.Origin + FVector(Rect.Min.X * Size, Rect.Min.Y * Size, 0.0f);
+                const FVector Max = Layout.Origin + FVector(Rect.Max.X * Size, Rect.Max.Y * Size, 0.0f);
 
-                float NeighborCost = FlowFieldGrid[GridToIndex(Neighbor)].Cost;
-                if (NeighborCost < LowestCost)
+                FDebugDrawChunk& Chunk = DebugChunks.AddDefaulted_GetRef();
+                Chunk.Bounds = FBox(Min - FVector(0.0f, 0.0f, Size), Max + FVector(0.0f, 0.0f, Size));
+
+                // Cell boundaries in white, one line per grid row and column rather than a box per cell
+                for (int32 X = Rect.Min.X; X <= Rect.Max.X; ++X)
                 {
-                    LowestCost = NeighborCost;
-                    LowestCostNeighbor = Neighbor;
+                    const double LineX = Layout.Origin.X + X * Size;
+                    Chunk.Lines.Emplace(FVector(LineX, Min.Y, Min.Z), FVector(LineX, Max.Y, Min.Z), FLinearColor::White, 0.0f, 1.0f, SDPG_World);
+                }
+                for (int32 Y = Rect.Min.Y; Y <= Rect.Max.Y; ++Y)
+                {
+                    const double LineY = Layout.Origin.Y + Y * Size;
+                    Chunk.Lines.Emplace(FVector(Min.X, LineY, Min.Z), FVector(Max.X, LineY, Min.Z), FLinearColor::White, 0.0f, 1.0f, SDPG_World);
                 }
-            }
 
-            if (LowestCostNeighbor != Current)
-            {
-                FlowFieldGrid[GridToIndex(Current)].FlowDirection = (LowestCostNeighbor - Current).GetSafeNormal();
+                // Flow directions in blue
+                for (int32 Y = Rect.Min.Y; Y < Rect.Max.Y; ++Y)
+                {
+                    for (int32 X = Rect.Min.X; X < Rect.Max.X; ++X)
+                    {
+                        const uint8 Direction = Directions[Layout.CellToIndex(FIntPoint(X, Y))];
+                        if (Direction == FFlowField::NoDirection)
+                            continue;
+
+                        const FVector2f Direction2D = FFlowField::DecodeDirection(Direction);
+                        const FVector FlowDirection(Direction2D.X, Direction2D.Y, 0.0f);
+                        const FVector Side(-Direction2D.Y, Direction2D.X, 0.0f);
+                        const FVector Start = Layout.CellToWorld(FIntPoint(X, Y));
+                        const FVector Tip = Start + FlowDirection * Size * 0.5f;
+
+                        Chunk.Lines.Emplace(Start, Tip, FLinearColor::Blue, 0.0f, 2.0f, SDPG_World);
+                        Chunk.Lines.Emplace(Tip, Tip - (FlowDirection - Side * 0.5f) * ArrowSize, FLinearColor::Blue, 0.0f, 2.0f, SDPG_World);
+                        Chunk.Lines.Emplace(Tip, Tip - (FlowDirection + Side * 0.5f) * ArrowSize, FLinearColor::Blue, 0.0f, 2.0f, SDPG_World);
+                    }
+                }
             }
         }
     }
 }
 
-TArray<FVector2D> AFlowFieldSystem::GetNeighbors(const FVector2D& Location) const
+TBitArray<> AFlowFieldSystem::GetVisibleDebugChunks() const
 {
-    TArray<FVector2D> Neighbors;
-    Neighbors.Add(Location + FVector2D(1, 0));  // Right
-    Neighbors.Add(Location + FVector2D(-1, 0)); // Left
-    Neighbors.Add(Location + FVector2D(0, 1));  // Up
-    Neighbors.Add(Location + FVector2D(0, -1)); // Down
-    return Neighbors;
-}
+    TBitArray<> VisibleChunks(true, DebugChunks.Num());
 
-float AFlowFieldSystem::CalculateCost(const FVector2D& Current, const FVector2D& Target) const
-{
-    // Basic Euclidean distance
-    return FVector2D::Distance(Current, Target);
-}
+    // Without a local view (dedicated server, commandlets) everything counts as visible
+    APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+    ULocalPlayer* LocalPlayer = PlayerController ? PlayerController->GetLocalPlayer() : nullptr;
+    if (!LocalPlayer || !LocalPlayer->ViewportClient)
+        return VisibleChunks;
 
-FVector AFlowFieldSystem::GetFlowDirection(const FVector& WorldLocation) const
-{
-    FVector2D GridLocation = WorldToGrid(WorldLocation);
-    if (!IsValidGridLocation(GridLocation))
-        return FVector::ZeroVector;
+    FSceneViewProjectionData ProjectionData;
+    if (!LocalPlayer->GetProjectionData(LocalPlayer->ViewportClient->Viewport, ProjectionData))
+        return VisibleChunks;
 
-    // Get the flow direction from the grid
-    FVector2D FlowDirection2D = FlowFieldGrid[GridToIndex(GridLocation)].FlowDirection;
-    
-    // If we have no flow direction, calculate direct path to target
-    if (FlowDirection2D.IsNearlyZero())
-    {
-        // Get direct vector to target (this is a fallback if flow field hasn't been calculated)
-        FVector DirectPath = (WorldLocation - GetActorLocation()).GetSafeNormal();
-        return DirectPath;
-    }
-
-    // Convert 2D direction to 3D and ensure it's normalized
-    return FVector(FlowDirection2D.X, FlowDirection2D.Y, 0.0f).GetSafeNormal();
-}
+    FConvexVolume Frustum;
+    GetViewFrustumBounds(Frustum, ProjectionData.ComputeViewProjectionMatrix(), false);
 
-void AFlowFieldSystem::DrawDebugFlowField() const
-{
-    for (int32 Y = 0; Y < GridHeight; ++Y)
+    for (int32 ChunkIndex = 0; ChunkIndex < DebugChunks.Num(); ++ChunkIndex)
     {
-        for (int32 X = 0; X < GridWidth; ++X)
-        {
-            FVector2D GridLocation(X, Y);
-            FVector WorldLocation = GridToWorld(GridLocation);
-            FVector FlowDirection = FVector(FlowFieldGrid[GridToIndex(GridLocation)].FlowDirection, 0.0f);
-
-            // Draw flow direction in blue
-            DrawDebugDirectionalArrow(
-                GetWorld(),
-                WorldLocation,
-                WorldLocation + FlowDirection * CellSize * 0.5f,
-                20.0f,
-                FColor::Blue,
-                false,
-                -1.0f,
-                0,
-                2.0f
-            );
-
-            // Draw cell boundaries in white
-            DrawDebugBox(
-                GetWorld(),
-                WorldLocation,
-                FVector(CellSize * 0.5f, CellSize * 0.5f, 0.0f),
-                FColor::White,
-                false,
-                -1.0f,
-                0,
-                1.0f
-            );
-        }
+        const FBox& Bounds = DebugChunks[ChunkIndex].Bounds;
+        VisibleChunks[ChunkIndex] = Frustum.IntersectBox(Bounds.GetCenter(), Bounds.GetExtent());
     }
-} 
\ No newline at end of file
+    return VisibleChunks;
+}
@@ -2,24 +2,13 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Components/LineBatchComponent.h"
+#include "FlowField.h"
 #include "FlowFieldSystem.generated.h"
 
-USTRUCT(BlueprintType)
-struct FFlowFieldCell
-{
-    GENERATED_BODY()
-
-    UPROPERTY(BlueprintReadWrite, Category = "Flow Field")
-    FVector2D FlowDirection;
+class AFlowFieldSystem;
 
-    UPROPERTY(BlueprintReadWrite, Category = "Flow Field")
-    float Cost;
-
-    FFlowFieldCell()
-        : FlowDirection(FVector2D::ZeroVector)
-        , Cost(0.0f)
-    {}
-};
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnFlowFieldUpdated, AFlowFieldSystem*, FlowFieldSystem);
 
 UCLASS()
 class PROTOTYPE1_API AFlowFieldSystem : public AActor
@@ -30,19 +19,36 @@ public:
     AFlowFieldSystem();
 
     virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
     virtual void Tick(float DeltaTime) override;
 
     // Initialize the flow field grid
     void InitializeFlowField(const FVector& WorldSize, float CellSize);
 
-    // Update flow field for a new target location
+    // Update flow field for a new target location. With async updates the previous field
+    // keeps being used until the new one is ready, and any older pending update is cancelled.
     void UpdateFlowField(const FVector& TargetLocation);
 
+    // Update flow field to lead to the nearest cell of a goal area, so units spread over it instead of queueing for one cell
+    void UpdateFlowField(const FFlowFieldGoal& Goal);
+
+    // Drop the pending update, if any, and keep the current field
+    void CancelPendingUpdate();
+
+    // Whether a newer field is still being built
+    bool IsUpdatePending() const { return PendingRequestId != 0; }
+
     // Get flow direction at a world location
     FVector GetFlowDirection(const FVector& WorldLocation) const;
 
-    // Debug visualization
-    void DrawDebugFlowField() const;
+    // Debug visualization, drawn while FlowField.DebugDraw is set. Lines are rebuilt only when the field
+    // changes and resubmitted only when the set of chunks in view changes.
+    void UpdateDebugDraw();
+    static bool IsDebugDrawEnabled();
+
+    // Broadcast when a new field has been swapped in
+    UPROPERTY(BlueprintAssignable, Category = "Flow Field")
+    FOnFlowFieldUpdated OnFlowFieldUpdated;
 
 protected:
     // Grid properties
@@ -52,26 +58,35 @@ protected:
     UPROPERTY(EditAnywhere, Category = "Flow Field")
     float CellSize;
 
-    // Grid dimensions
-    int32 GridWidth;
-    int32 GridHeight;
-
-    // The actual flow field data
-    TArray<FFlowFieldCell> FlowFieldGrid;
-
-    // Helper functions
-    FVector2D WorldToGrid(const FVector& WorldLocation) const;
-    FVector GridToWorld(const FVector2D& GridLocation) const;
-    int32 GridToIndex(const FVector2D& GridLocation) const;
-    bool IsValidGridLocation(const FVector2D& GridLocation) const;
+    // Build fields on a worker thread instead of inside UpdateFlowField
+    UPROPERTY(EditAnywhere, Category = "Flow Field")
+    bool bAsyncUpdates;
 
-    // Flow field calculation
-    void CalculateFlowField(const FVector& TargetLocation);
-    void PropagateCosts(const FVector2D& TargetGridLocation);
-    void CalculateFlowDirections();
+    // The last complete field, shared through the flow field subsystem's cache
+    TSharedPtr<const IFlowField> FlowField;
 
 private:
-    // Cost calculation helpers
-    float CalculateCost(const FVector2D& Current, const FVector2D& Target) const;
-    TArray<FVector2D> GetNeighbors(const FVector2D& Location) const;
-}; 
\ No newline at end of file
+    void OnFlowFieldReady(TSharedPtr<const IFlowField> NewField);
+
+    // Debug lines for a square block of cells, culled against the view as a whole
+    struct FDebugDrawChunk
+    {
+        FBox Bounds;
+        TArray<FBatchedLine> Lines;
+    };
+
+    void BuildDebugChunks(const TArray<const FFlowField*>& Fields);
+    TBitArray<> GetVisibleDebugChunks() const;
+
+    // Created the first time debug drawing is switched on
+    UPROPERTY()
+    ULineBatchComponent* DebugLines;
+
+    TArray<FDebugDrawChunk> DebugChunks;
+    TBitArray<> SubmittedDebugChunks;
+    uint32 DebugFieldSignature;
+
+    // Request for the field that will replace FlowField, 0 if none
+    uint64 PendingRequestId;
+    FFlowFieldGoal PendingGoal;
+};
\ No newline at end of file
@@ -1,8 +1,6 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "GameFramework/Actor.h"
-#include "Components/StaticMeshComponent.h"
 #include "GridCell.generated.h"
 
 UENUM(BlueprintType)
@@ -13,43 +11,29 @@ enum class ECellState : uint8
     Blocked     UMETA(DisplayName = "Blocked")
 };
 
-UCLASS()
-class PROTOTYPE1_API AGridCell : public AActor
+// One grid cell packed into a byte: the cell state in the low two bits, then the walkable and buildable flags.
+// AGridManager keeps these in lazily allocated 64x64 chunks; what the cells look like is up to its optional visual layer.
+struct FGridCell
 {
-    GENERATED_BODY()
+    static constexpr uint8 StateMask = 0x3;
+    static constexpr uint8 WalkableBit = 1 << 2;
+    static constexpr uint8 BuildableBit = 1 << 3;
 
-public:
-    AGridCell();
+    uint8 Bits = WalkableBit | BuildableBit;
 
-    // Cell properties
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grid")
-    ECellState CellState;
+    ECellState GetState() const { return static_cast<ECellState>(Bits & StateMask); }
+    bool IsWalkable() const { return (Bits & WalkableBit) != 0; }
+    bool IsBuildable() const { return (Bits & BuildableBit) != 0; }
 
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grid")
-    bool bIsBuildable;
+    // Empty, walkable and buildable, as every cell starts
+    bool IsDefault() const { return Bits == FGridCell().Bits; }
 
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grid")
-    bool bIsWalkable;
+    // Free to build on
+    bool IsAvailable() const { return GetState() == ECellState::Empty && IsBuildable(); }
 
-    // Grid position
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grid")
-    int32 GridX;
-
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grid")
-    int32 GridY;
-
-    // Cell size
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Grid")
-    float CellSize;
-
-    // Functions
-    void InitializeCell(int32 X, int32 Y, float Size);
-    bool IsAvailable() const;
-    FVector GetCenterLocation() const;
-    void SetCellState(ECellState NewState);
-    void HighlightCell(bool bHighlight);
+    void SetState(ECellState NewState) { Bits = (Bits & ~StateMask) | (static_cast<uint8>(NewState) & StateMask); }
+    void SetWalkable(bool bWalkable) { Bits = bWalkable ? (Bits | WalkableBit) : (Bits & ~WalkableBit); }
+    void SetBuildable(bool bBuildable) { Bits = bBuildable ? (Bits | BuildableBit) : (Bits & ~BuildableBit); }
+};
 
-protected:
-    UPROPERTY(VisibleAnywhere, Category = "Grid")
-    UStaticMeshComponent* StaticMeshComponent;
-}; 
\ No newline at end of file
+static_assert(sizeof(FGridCell) == 1, "Grid cells are meant to pack into one byte each"); 
\ No newline at end of file
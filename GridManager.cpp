@@ -1,14 +1,109 @@
 #include "GridManager.h"
+#include "FlowFieldSubsystem.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/Texture2D.h"
+#include "Materials/MaterialInstanceDynamic.h"
 #include "Kismet/GameplayStatics.h"
 
+static FLinearColor GetCellStateColor(ECellState State)
+{
+    switch (State)
+    {
+        case ECellState::Occupied:
+            return FLinearColor(0.5f, 0.5f, 0.5f, 0.5f);
+        case ECellState::Blocked:
+            return FLinearColor(0.8f, 0.2f, 0.2f, 0.5f);
+        default:
+            return FLinearColor(0.2f, 0.2f, 0.2f, 0.5f);
+    }
+}
+
+// Bit per cell of a 64-cell chunk row, set where (Bits & Mask) == Value. Eight cells go through at a time as a
+// little-endian word: the XOR leaves a zero byte for each match, the zero-byte test sets that byte's top bit, and the
+// multiply gathers the eight top bits into one byte.
+static uint64 MatchChunkRow(const FGridCell* Row, uint8 Mask, uint8 Value)
+{
+    constexpr uint64 Ones = 0x0101010101010101ull;
+    constexpr uint64 Low7 = Ones * 0x7F;
+
+    uint64 Result = 0;
+    for (int32 Word = 0; Word < 8; ++Word)
+    {
+        uint64 Bytes;
+        FMemory::Memcpy(&Bytes, Row + Word * 8, sizeof(Bytes));
+
+        const uint64 Diff = (Bytes & (Ones * Mask)) ^ (Ones * Value);
+        const uint64 ZeroBytes = ~(((Diff & Low7) + Low7) | Diff | Low7);
+        Result |= (((ZeroBytes >> 7) * 0x0102040810204080ull) >> 56) << (Word * 8);
+    }
+    return Result;
+}
+
+// The reverse: 0xFF in byte I for each set bit I
+static uint64 SpreadBitsToBytes(uint8 Bits)
+{
+    uint64 Spread = Bits;
+    Spread = (Spread | (Spread << 28)) & 0x0000000F0000000Full;
+    Spread = (Spread | (Spread << 14)) & 0x0003000300030003ull;
+    Spread = (Spread | (Spread << 7)) & 0x0101010101010101ull;
+    return Spread * 0xFF;
+}
+
+static uint64 MatchAvailableCells(const FGridCell* Row)
+{
+    return MatchChunkRow(Row, FGridCell::StateMask | FGridCell::BuildableBit, FGridCell::BuildableBit);
+}
+
+static int32 CountDefaultCells(const FGridCell* Row)
+{
+    return FMath::CountBits(MatchChunkRow(Row, 0xFF, FGridCell().Bits));
+}
+
+// Grow Bounds over the cells set in Changed, bit 0 being cell (MinX, Y)
+static void IncludeChangedCells(FIntRect& Bounds, int32 MinX, int32 Y, uint64 Changed)
+{
+    if (!Changed)
+        return;
+
+    const FIntRect RowBounds(MinX + FMath::CountTrailingZeros64(Changed), Y, MinX + 64 - FMath::CountLeadingZeros64(Changed), Y + 1);
+    if (Bounds.Area() == 0)
+    {
+        Bounds = RowBounds;
+    }
+    else
+    {
+        Bounds.Union(RowBounds);
+    }
+}
+
 AGridManager::AGridManager()
 {
-    PrimaryActorTick.bCanEverTick = false;
+    // Only ticks to upload cell changes, and only while there are some
+    PrimaryActorTick.bCanEverTick = true;
+    PrimaryActorTick.bStartWithTickEnabled = false;
 
     // Set default grid properties
     GridWidth = 20;
     GridHeight = 20;
     CellSize = 100.0f;
+    GridPlaneMesh = nullptr;
+    GridMaterial = nullptr;
+
+    RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+
+    GridPlane = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("GridPlane"));
+    GridPlane->SetupAttachment(RootComponent);
+    GridPlane->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+    GridPlane->SetGenerateOverlapEvents(false);
+    GridPlane->SetCastShadow(false);
+
+    NumChunksX = 0;
+    NumAllocatedChunks = 0;
+    ChunkTotalsDirtyMin = FIntPoint::ZeroValue;
+    bChunkTotalsDirty = false;
+    CellStateTexture = nullptr;
+    GridMaterialInstance = nullptr;
+    bCellVisualsDirty = false;
 }
 
 void AGridManager::BeginPlay()
@@ -19,48 +114,73 @@ void AGridManager::BeginPlay()
 
 void AGridManager::CreateGrid(int32 Width, int32 Height, float InCellSize)
 {
-    // Clear existing grid if any
-    for (AGridCell* Cell : GridCells)
+    GridWidth = FMath::Max(Width, 0);
+    GridHeight = FMath::Max(Height, 0);
+    CellSize = InCellSize;
+
+    // Every cell starts empty, walkable and buildable, which needs no chunks at all
+    NumChunksX = FMath::DivideAndRoundUp(GridWidth, ChunkSize);
+    Chunks.Reset();
+    Chunks.SetNum(NumChunksX * FMath::DivideAndRoundUp(GridHeight, ChunkSize));
+    NumAllocatedChunks = 0;
+
+    // All available, so every total starts at zero
+    ChunkUnavailableSums.Reset();
+    ChunkUnavailableSums.SetNumZeroed((NumChunksX + 1) * (GetNumChunksY() + 1));
+    bChunkTotalsDirty = false;
+
+    RebuildCellVisuals();
+
+    // The flow field mirrors the cells, so it has to be reset along with them
+    SyncFlowFieldCosts();
+}
+
+const FGridCell* AGridManager::GetCell(int32 X, int32 Y) const
+{
+    static const FGridCell DefaultCell;
+
+    if (!IsValidGridPosition(X, Y))
+        return nullptr;
+
+    const FGridChunk* Chunk = Chunks[GetChunkIndex(X, Y)].Get();
+    return Chunk ? &Chunk->Cells[GetIndexInChunk(X, Y)] : &DefaultCell;
+}
+
+void AGridManager::WriteCell(int32 X, int32 Y, FGridCell NewCell)
+{
+    const int32 ChunkIndex = GetChunkIndex(X, Y);
+    TUniquePtr<FGridChunk>& Chunk = Chunks[ChunkIndex];
+    if (!Chunk)
     {
-        if (Cell)
-        {
-            Cell->Destroy();
-        }
+        if (NewCell.IsDefault())
+            return;
+
+        Chunk = MakeUnique<FGridChunk>();
+        ++NumAllocatedChunks;
     }
-    GridCells.Empty();
 
-    // Create new grid
-    for (int32 Y = 0; Y < Height; ++Y)
+    FGridCell& Cell = Chunk->Cells[GetIndexInChunk(X, Y)];
+    Chunk->NumNonDefault += int32(!NewCell.IsDefault()) - int32(!Cell.IsDefault());
+    Cell = NewCell;
+
+    const uint64 CellBit = uint64(1) << (X & (ChunkSize - 1));
+    uint64& AvailableRow = Chunk->AvailableRows[Y & (ChunkSize - 1)];
+    if (((AvailableRow & CellBit) != 0) != NewCell.IsAvailable())
     {
-        for (int32 X = 0; X < Width; ++X)
-        {
-            if (GridCellClass)
-            {
-                FVector Location = GridToWorld(X, Y);
-                AGridCell* NewCell = GetWorld()->SpawnActor<AGridCell>(GridCellClass, Location, FRotator::ZeroRotator);
-                if (NewCell)
-                {
-                    NewCell->InitializeCell(X, Y, InCellSize);
-                    GridCells.Add(NewCell);
-                }
-            }
-        }
+        AvailableRow ^= CellBit;
+        MarkAvailabilityDirty(*Chunk, ChunkIndex, NewCell.IsAvailable() ? -1 : 1);
     }
-}
 
-AGridCell* AGridManager::GetCell(int32 X, int32 Y) const
-{
-    if (IsValidGridPosition(X, Y))
+    if (Chunk->NumNonDefault == 0)
     {
-        int32 Index = Y * GridWidth + X;
-        return GridCells[Index];
+        Chunk.Reset();
+        --NumAllocatedChunks;
     }
-    return nullptr;
 }
 
 bool AGridManager::IsValidGridPosition(int32 X, int32 Y) const
 {
-    return X >= 0 && X < GridWidth && Y >= 0 && Y < GridHeight;
+    return X >= 0 && X < GridWidth && Y >= 0 && Y < GridHeight && Chunks.Num() > 0;
 }
 
 FVector2D AGridManager::WorldToGrid(const FVector& WorldLocation) const
@@ -79,25 +199,575 @@ FVector AGridManager::GridToWorld(int32 X, int32 Y) const
 
 bool AGridManager::IsCellAvailable(int32 X, int32 Y) const
 {
-    if (AGridCell* Cell = GetCell(X, Y))
+    const FGridCell* Cell = GetCell(X, Y);
+    return Cell && Cell->IsAvailable();
+}
+
+void AGridManager::SetCellState(int32 X, int32 Y, ECellState NewState)
+{
+    if (!IsValidGridPosition(X, Y))
+        return;
+
+    FGridCell Cell = *GetCell(X, Y);
+    Cell.SetState(NewState);
+    WriteCell(X, Y, Cell);
+    UpdateCellVisual(X, Y);
+    UpdateFlowFieldCost(X, Y, GetTraversalCost(NewState, Cell.IsWalkable()));
+}
+
+void AGridManager::SetCellWalkable(int32 X, int32 Y, bool bWalkable)
+{
+    if (!IsValidGridPosition(X, Y))
+        return;
+
+    FGridCell Cell = *GetCell(X, Y);
+    Cell.SetWalkable(bWalkable);
+    WriteCell(X, Y, Cell);
+    UpdateFlowFieldCost(X, Y, GetTraversalCost(Cell.GetState(), bWalkable));
+}
+
+void AGridManager::SetCellBuildable(int32 X, int32 Y, bool bBuildable)
+{
+    if (IsValidGridPosition(X, Y))
     {
-        return Cell->IsAvailable();
+        FGridCell Cell = *GetCell(X, Y);
+        Cell.SetBuildable(bBuildable);
+        WriteCell(X, Y, Cell);
     }
-    return false;
 }
 
-void AGridManager::SetCellState(int32 X, int32 Y, ECellState NewState)
+uint64 AGridManager::GetChunkColumnMask(int32 ChunkX, int32 MinX, int32 MaxX)
+{
+    const int32 ChunkMinX = ChunkX * ChunkSize;
+    const int32 Lo = FMath::Max(MinX - ChunkMinX, 0);
+    const int32 Hi = FMath::Min(MaxX - ChunkMinX, ChunkSize);
+    if (Lo >= Hi)
+        return 0;
+
+    const uint64 Span = Hi - Lo == ChunkSize ? ~uint64(0) : (uint64(1) << (Hi - Lo)) - 1;
+    return Span << Lo;
+}
+
+uint64 AGridManager::SetChunkRowState(int32 ChunkX, int32 Y, uint64 CellMask, ECellState NewState)
+{
+    if (!CellMask)
+        return 0;
+
+    const int32 ChunkIndex = (Y >> ChunkShift) * NumChunksX + ChunkX;
+    TUniquePtr<FGridChunk>& Chunk = Chunks[ChunkIndex];
+    if (!Chunk)
+    {
+        // Unallocated cells are all default, which is already empty
+        if (NewState == ECellState::Empty)
+            return 0;
+
+        Chunk = MakeUnique<FGridChunk>();
+        ++NumAllocatedChunks;
+    }
+
+    const int32 LocalY = Y & (ChunkSize - 1);
+    FGridCell* Row = &Chunk->Cells[LocalY * ChunkSize];
+    const uint8 State = static_cast<uint8>(NewState);
+
+    const uint64 Changed = CellMask & ~MatchChunkRow(Row, FGridCell::StateMask, State);
+    if (!Changed)
+        return 0;
+
+    // Rewrite the state bits of the changed cells eight at a time, leaving their flags alone
+    const int32 DefaultBefore = CountDefaultCells(Row);
+    for (int32 Word = 0; Word < 8; ++Word)
+    {
+        const uint8 WordChanged = uint8(Changed >> (Word * 8));
+        if (!WordChanged)
+            continue;
+
+        const uint64 StateBits = SpreadBitsToBytes(WordChanged) & (0x0101010101010101ull * FGridCell::StateMask);
+        uint64 Bytes;
+        FMemory::Memcpy(&Bytes, Row + Word * 8, sizeof(Bytes));
+        Bytes = (Bytes & ~StateBits) | (StateBits & (0x0101010101010101ull * State));
+        FMemory::Memcpy(Row + Word * 8, &Bytes, sizeof(Bytes));
+    }
+
+    Chunk->NumNonDefault += DefaultBefore - CountDefaultCells(Row);
+
+    const uint64 Available = MatchAvailableCells(Row);
+    if (Available != Chunk->AvailableRows[LocalY])
+    {
+        const int32 UnavailableDelta = FMath::CountBits(Chunk->AvailableRows[LocalY]) - FMath::CountBits(Available);
+        Chunk->AvailableRows[LocalY] = Available;
+        MarkAvailabilityDirty(*Chunk, ChunkIndex, UnavailableDelta);
+    }
+
+    if (Chunk->NumNonDefault == 0)
+    {
+        Chunk.Reset();
+        --NumAllocatedChunks;
+    }
+    return Changed;
+}
+
+bool AGridManager::IsChunkRowAvailable(int32 ChunkX, int32 Y, uint64 CellMask) const
+{
+    if (!CellMask)
+        return true;
+
+    // Cells in unallocated chunks are default, and so available
+    const FGridChunk* Chunk = Chunks[(Y >> ChunkShift) * NumChunksX + ChunkX].Get();
+    return !Chunk || (Chunk->AvailableRows[Y & (ChunkSize - 1)] & CellMask) == CellMask;
+}
+
+FIntRect AGridManager::FillRegion(const FIntRect& Rect, ECellState NewState)
+{
+    FIntRect DirtyBounds(0, 0, 0, 0);
+
+    FIntRect Clipped = Rect;
+    Clipped.Clip(FIntRect(0, 0, GridWidth, GridHeight));
+    if (Chunks.Num() == 0 || Clipped.Width() <= 0 || Clipped.Height() <= 0)
+        return DirtyBounds;
+
+    const int32 FirstChunkX = Clipped.Min.X >> ChunkShift;
+    const int32 LastChunkX = (Clipped.Max.X - 1) >> ChunkShift;
+    for (int32 Y = Clipped.Min.Y; Y < Clipped.Max.Y; ++Y)
+    {
+        for (int32 ChunkX = FirstChunkX; ChunkX <= LastChunkX; ++ChunkX)
+        {
+            const uint64 Changed = SetChunkRowState(ChunkX, Y, GetChunkColumnMask(ChunkX, Clipped.Min.X, Clipped.Max.X), NewState);
+            UpdateChangedCells(ChunkX * ChunkSize, Y, Changed);
+            IncludeChangedCells(DirtyBounds, ChunkX * ChunkSize, Y, Changed);
+        }
+    }
+    return DirtyBounds;
+}
+
+bool AGridManager::IsFootprintAvailable(const FGridFootprint& Footprint, const FIntPoint& Origin) const
+{
+    const int32 Width = FMath::Clamp(Footprint.Width, 0, ChunkSize);
+    if (Chunks.Num() == 0 || Origin.X < 0 || Origin.Y < 0 || Origin.X + Width > GridWidth || Origin.Y + Footprint.GetHeight() > GridHeight)
+        return false;
+
+    // Each footprint row lands in at most two chunk columns
+    const uint64 WidthMask = GetChunkColumnMask(0, 0, Width);
+    const int32 ChunkX = Origin.X >> ChunkShift;
+    const int32 Offset = Origin.X & (ChunkSize - 1);
+    for (int32 Row = 0; Row < Footprint.GetHeight(); ++Row)
+    {
+        const uint64 RowMask = Footprint.Rows[Row] & WidthMask;
+        const int32 Y = Origin.Y + Row;
+        if (!IsChunkRowAvailable(ChunkX, Y, RowMask << Offset)
+            || (Offset != 0 && !IsChunkRowAvailable(ChunkX + 1, Y, RowMask >> (ChunkSize - Offset))))
+            return false;
+    }
+    return true;
+}
+
+FIntRect AGridManager::SetFootprintState(const FGridFootprint& Footprint, const FIntPoint& Origin, ECellState NewState)
+{
+    FIntRect DirtyBounds(0, 0, 0, 0);
+    if (Chunks.Num() == 0)
+        return DirtyBounds;
+
+    // Shifting into place and masking off columns beyond the grid's edges clips the footprint, so rows need no other checks
+    const uint64 WidthMask = GetChunkColumnMask(0, 0, FMath::Clamp(Footprint.Width, 0, ChunkSize));
+    const int32 ChunkX = Origin.X >> ChunkShift;
+    const int32 Offset = Origin.X & (ChunkSize - 1);
+    for (int32 Row = 0; Row < Footprint.GetHeight(); ++Row)
+    {
+        const int32 Y = Origin.Y + Row;
+        if (Y < 0 || Y >= GridHeight)
+            continue;
+
+        const uint64 RowMask = Footprint.Rows[Row] & WidthMask;
+        const uint64 Parts[2] = { RowMask << Offset, Offset != 0 ? RowMask >> (ChunkSize - Offset) : 0 };
+        for (int32 Part = 0; Part < 2; ++Part)
+        {
+            const int32 PartChunkX = ChunkX + Part;
+            const uint64 Changed = SetChunkRowState(PartChunkX, Y, Parts[Part] & GetChunkColumnMask(PartChunkX, 0, GridWidth), NewState);
+            UpdateChangedCells(PartChunkX * ChunkSize, Y, Changed);
+            IncludeChangedCells(DirtyBounds, PartChunkX * ChunkSize, Y, Changed);
+        }
+    }
+    return DirtyBounds;
+}
+
+void AGridManager::MarkAvailabilityDirty(FGridChunk& Chunk, int32 ChunkIndex, int32 UnavailableDelta)
+{
+    Chunk.NumUnavailable += UnavailableDelta;
+    Chunk.bSumsDirty = true;
+
+    const FIntPoint ChunkCoords(ChunkIndex % NumChunksX, ChunkIndex / NumChunksX);
+    if (bChunkTotalsDirty)
+    {
+        ChunkTotalsDirtyMin = ChunkTotalsDirtyMin.ComponentMin(ChunkCoords);
+    }
+    else
+    {
+        ChunkTotalsDirtyMin = ChunkCoords;
+        bChunkTotalsDirty = true;
+    }
+}
+
+void AGridManager::UpdateChunkTotals() const
+{
+    if (!bChunkTotalsDirty)
+        return;
+
+    bChunkTotalsDirty = false;
+
+    // A chunk per entry, so even a full pass is a few thousand adds on the largest maps
+    const int32 Stride = NumChunksX + 1;
+    const int32 MinX = ChunkTotalsDirtyMin.X;
+    for (int32 ChunkY = ChunkTotalsDirtyMin.Y; ChunkY < GetNumChunksY(); ++ChunkY)
+    {
+        const int32* Above = &ChunkUnavailableSums[ChunkY * Stride];
+        int32* Sums = &ChunkUnavailableSums[(ChunkY + 1) * Stride];
+
+        // The row's total left of the dirty column hasn't changed, so carry on from there
+        int32 RowCount = Sums[MinX] - Above[MinX];
+        for (int32 ChunkX = MinX; ChunkX < NumChunksX; ++ChunkX)
+        {
+            const FGridChunk* Chunk = Chunks[ChunkY * NumChunksX + ChunkX].Get();
+            RowCount += Chunk ? Chunk->NumUnavailable : 0;
+            Sums[ChunkX + 1] = Above[ChunkX + 1] + RowCount;
+        }
+    }
+}
+
+void AGridManager::UpdateChunkSums(const FGridChunk& Chunk)
+{
+    if (!Chunk.bSumsDirty)
+        return;
+
+    Chunk.bSumsDirty = false;
+
+    for (int32 LocalY = 0; LocalY < ChunkSize; ++LocalY)
+    {
+        uint16* Sums = &Chunk.UnavailableSums[LocalY * ChunkSize];
+        const uint16* Above = LocalY > 0 ? Sums - ChunkSize : nullptr;
+        const uint64 Unavailable = ~Chunk.AvailableRows[LocalY];
+
+        // Rows with nothing unavailable just repeat the row above
+        if (!Unavailable)
+        {
+            if (Above)
+            {
+                FMemory::Memcpy(Sums, Above, ChunkSize * sizeof(uint16));
+            }
+            else
+            {
+                FMemory::Memzero(Sums, ChunkSize * sizeof(uint16));
+            }
+            continue;
+        }
+
+        uint16 RowCount = 0;
+        for (int32 LocalX = 0; LocalX < ChunkSize; ++LocalX)
+        {
+            RowCount += uint16((Unavailable >> LocalX) & 1);
+            Sums[LocalX] = uint16((Above ? Above[LocalX] : 0) + RowCount);
+        }
+    }
+}
+
+int32 AGridManager::CountUnavailableInChunk(const FGridChunk* Chunk, const FIntRect& LocalRect)
+{
+    if (!Chunk || Chunk->NumUnavailable == 0)
+        return 0;
+
+    UpdateChunkSums(*Chunk);
+
+    // Cells left of X and above Y
+    auto SumBefore = [Chunk](int32 X, int32 Y)
+    {
+        return X > 0 && Y > 0 ? int32(Chunk->UnavailableSums[(Y - 1) * ChunkSize + X - 1]) : 0;
+    };
+    return SumBefore(LocalRect.Max.X, LocalRect.Max.Y) - SumBefore(LocalRect.Max.X, LocalRect.Min.Y)
+        - SumBefore(LocalRect.Min.X, LocalRect.Max.Y) + SumBefore(LocalRect.Min.X, LocalRect.Min.Y);
+}
+
+int32 AGridManager::CountUnavailableInRect(const FIntRect& Rect) const
+{
+    // Chunks the rectangle covers entirely come from the chunk totals, and only those along its edges are looked into
+    const FIntRect TouchedChunks(Rect.Min.X >> ChunkShift, Rect.Min.Y >> ChunkShift, ((Rect.Max.X - 1) >> ChunkShift) + 1, ((Rect.Max.Y - 1) >> ChunkShift) + 1);
+    const FIntRect FullChunks(FMath::DivideAndRoundUp(Rect.Min.X, ChunkSize), FMath::DivideAndRoundUp(Rect.Min.Y, ChunkSize), Rect.Max.X >> ChunkShift, Rect.Max.Y >> ChunkShift);
+    const bool bHasFullChunks = FullChunks.Width() > 0 && FullChunks.Height() > 0;
+
+    int32 Count = 0;
+    if (bHasFullChunks)
+    {
+        const int32 Stride = NumChunksX + 1;
+        Count += ChunkUnavailableSums[FullChunks.Max.Y * Stride + FullChunks.Max.X] - ChunkUnavailableSums[FullChunks.Min.Y * Stride + FullChunks.Max.X]
+            - ChunkUnavailableSums[FullChunks.Max.Y * Stride + FullChunks.Min.X] + ChunkUnavailableSums[FullChunks.Min.Y * Stride + FullChunks.Min.X];
+    }
+
+    for (int32 ChunkY = TouchedChunks.Min.Y; ChunkY < TouchedChunks.Max.Y; ++ChunkY)
+    {
+        const bool bSkipFullChunks = bHasFullChunks && ChunkY >= FullChunks.Min.Y && ChunkY < FullChunks.Max.Y;
+        for (int32 ChunkX = TouchedChunks.Min.X; ChunkX < TouchedChunks.Max.X; ++ChunkX)
+        {
+            if (bSkipFullChunks && ChunkX == FullChunks.Min.X)
+            {
+                ChunkX = FullChunks.Max.X - 1;
+                continue;
+            }
+
+            const FIntPoint ChunkMin(ChunkX * ChunkSize, ChunkY * ChunkSize);
+            FIntRect LocalRect(Rect.Min.X - ChunkMin.X, Rect.Min.Y - ChunkMin.Y, Rect.Max.X - ChunkMin.X, Rect.Max.Y - ChunkMin.Y);
+            LocalRect.Clip(FIntRect(0, 0, ChunkSize, ChunkSize));
+            Count += CountUnavailableInChunk(Chunks[ChunkY * NumChunksX + ChunkX].Get(), LocalRect);
+        }
+    }
+    return Count;
+}
+
+int32 AGridManager::CountUnavailableCells(const FIntRect& Rect) const
+{
+    FIntRect Clipped = Rect;
+    Clipped.Clip(FIntRect(0, 0, GridWidth, GridHeight));
+    if (Chunks.Num() == 0 || Clipped.Width() <= 0 || Clipped.Height() <= 0)
+        return 0;
+
+    UpdateChunkTotals();
+    return CountUnavailableInRect(Clipped);
+}
+
+bool AGridManager::IsRegionAvailable(const FIntRect& Rect) const
+{
+    return Chunks.Num() > 0 && Rect.Width() > 0 && Rect.Height() > 0
+        && Rect.Min.X >= 0 && Rect.Min.Y >= 0 && Rect.Max.X <= GridWidth && Rect.Max.Y <= GridHeight
+        && CountUnavailableCells(Rect) == 0;
+}
+
+void AGridManager::FindRegionPlacements(const FIntRect& SearchArea, const FIntPoint& Size, TArray<FIntPoint>& OutOrigins) const
+{
+    FIntRect Clipped = SearchArea;
+    Clipped.Clip(FIntRect(0, 0, GridWidth, GridHeight));
+    if (Chunks.Num() == 0 || Size.X <= 0 || Size.Y <= 0 || Clipped.Width() < Size.X || Clipped.Height() < Size.Y)
+        return;
+
+    UpdateChunkTotals();
+
+    for (int32 Y = Clipped.Min.Y; Y <= Clipped.Max.Y - Size.Y; ++Y)
+    {
+        for (int32 X = Clipped.Min.X; X <= Clipped.Max.X - Size.X; ++X)
+        {
+            if (CountUnavailableInRect(FIntRect(X, Y, X + Size.X, Y + Size.Y)) == 0)
+            {
+                OutOrigins.Add(FIntPoint(X, Y));
+            }
+        }
+    }
+}
+
+void AGridManager::UpdateChangedCells(int32 MinX, int32 Y, uint64 Changed)
 {
-    if (AGridCell* Cell = GetCell(X, Y))
+    if (!Changed)
+        return;
+
+    if (HasCellVisuals())
     {
-        Cell->SetCellState(NewState);
+        for (uint64 Remaining = Changed; Remaining; Remaining &= Remaining - 1)
+        {
+            const int32 X = MinX + FMath::CountTrailingZeros64(Remaining);
+            FColor& Texel = CellTexels[Y * GridWidth + X];
+            const uint8 Highlight = Texel.A;
+            Texel = GetCellStateColor(GetCell(X, Y)->GetState()).ToFColor(false);
+            Texel.A = Highlight;
+        }
+        MarkCellVisualDirty(MinX + FMath::CountTrailingZeros64(Changed), Y);
+        MarkCellVisualDirty(MinX + 63 - FMath::CountLeadingZeros64(Changed), Y);
     }
+
+    // One area per run of adjacent changed cells with the same cost
+    uint64 Remaining = Changed;
+    while (Remaining)
+    {
+        const int32 Start = FMath::CountTrailingZeros64(Remaining);
+        const FGridCell* StartCell = GetCell(MinX + Start, Y);
+        const uint8 Cost = GetTraversalCost(StartCell->GetState(), StartCell->IsWalkable());
+
+        int32 End = Start + 1;
+        while (End < ChunkSize && (Remaining >> End) & 1)
+        {
+            const FGridCell* Cell = GetCell(MinX + End, Y);
+            if (GetTraversalCost(Cell->GetState(), Cell->IsWalkable()) != Cost)
+                break;
+            ++End;
+        }
+
+        UpdateFlowFieldCost(FIntRect(MinX + Start, Y, MinX + End, Y + 1), Cost);
+        Remaining &= End == ChunkSize ? 0 : ~uint64(0) << End;
+    }
+}
+
+uint8 AGridManager::GetTraversalCost(ECellState State, bool bWalkable)
+{
+    return bWalkable && State == ECellState::Empty ? FFlowFieldCostField::Open : FFlowFieldCostField::Impassable;
+}
+
+void AGridManager::SyncFlowFieldCosts()
+{
+    UWorld* World = GetWorld();
+    UFlowFieldSubsystem* FlowFieldSubsystem = World ? World->GetSubsystem<UFlowFieldSubsystem>() : nullptr;
+    if (!FlowFieldSubsystem)
+        return;
+
+    // One flow field cell per grid cell, so costs map across exactly
+    FlowFieldSubsystem->ConfigureGrid(GetActorLocation(), FVector(GridWidth * CellSize, GridHeight * CellSize, 0.0f), CellSize);
+
+    // Default cells are open. A freshly configured flow field already is, but one kept from an earlier grid of the same
+    // size still has that grid's costs; opening everything only touches the cells that differ.
+    FlowFieldSubsystem->SetAreaCost(FBox(GridToWorld(0, 0), GridToWorld(GridWidth, GridHeight)), FFlowFieldCostField::Open);
+
+    // After that only allocated chunks have anything to push
+    for (int32 ChunkIndex = 0; ChunkIndex < Chunks.Num(); ++ChunkIndex)
+    {
+        const FGridChunk* Chunk = Chunks[ChunkIndex].Get();
+        if (!Chunk)
+            continue;
+
+        const FIntPoint ChunkMin((ChunkIndex % NumChunksX) * ChunkSize, (ChunkIndex / NumChunksX) * ChunkSize);
+        for (int32 Y = ChunkMin.Y; Y < FMath::Min(ChunkMin.Y + ChunkSize, GridHeight); ++Y)
+        {
+            for (int32 X = ChunkMin.X; X < FMath::Min(ChunkMin.X + ChunkSize, GridWidth); ++X)
+            {
+                const FGridCell& Cell = Chunk->Cells[GetIndexInChunk(X, Y)];
+                if (!Cell.IsDefault())
+                {
+                    UpdateFlowFieldCost(X, Y, GetTraversalCost(Cell.GetState(), Cell.IsWalkable()));
+                }
+            }
+        }
+    }
+}
+
+void AGridManager::UpdateFlowFieldCost(int32 X, int32 Y, uint8 Cost)
+{
+    UpdateFlowFieldCost(FIntRect(X, Y, X + 1, Y + 1), Cost);
+}
+
+void AGridManager::UpdateFlowFieldCost(const FIntRect& Cells, uint8 Cost)
+{
+    // Cached fields are repaired around the change on the subsystem's next tick
+    if (UFlowFieldSubsystem* FlowFieldSubsystem = GetWorld()->GetSubsystem<UFlowFieldSubsystem>())
+    {
+        FlowFieldSubsystem->SetAreaCost(FBox(GridToWorld(Cells.Min.X, Cells.Min.Y), GridToWorld(Cells.Max.X, Cells.Max.Y)), Cost);
+    }
+}
+
+void AGridManager::RebuildCellVisuals()
+{
+    CellStateTexture = nullptr;
+    GridMaterialInstance = nullptr;
+    CellTexels.Reset();
+    bCellVisualsDirty = false;
+    SetActorTickEnabled(false);
+
+    if (!GridPlaneMesh || GridWidth * GridHeight == 0)
+    {
+        GridPlane->SetVisibility(false);
+        return;
+    }
+
+    // One texel per cell, sampled without filtering so cells keep hard edges
+    CellStateTexture = UTexture2D::CreateTransient(GridWidth, GridHeight, PF_B8G8R8A8);
+    if (!CellStateTexture)
+        return;
+
+    CellStateTexture->Filter = TF_Nearest;
+    CellStateTexture->SRGB = false;
+    CellStateTexture->AddressX = TA_Clamp;
+    CellStateTexture->AddressY = TA_Clamp;
+    CellStateTexture->CompressionSettings = TC_VectorDisplacementmap;
+    CellStateTexture->UpdateResource();
+
+    // The default plane is 100 units across, centred on its origin
+    GridPlane->SetStaticMesh(GridPlaneMesh);
+    GridPlane->SetRelativeLocation(FVector(GridWidth * CellSize * 0.5f, GridHeight * CellSize * 0.5f, 0.0f));
+    GridPlane->SetRelativeScale3D(FVector(GridWidth * CellSize / 100.0f, GridHeight * CellSize / 100.0f, 1.0f));
+    GridPlane->SetVisibility(true);
+
+    if (GridMaterial)
+    {
+        GridMaterialInstance = UMaterialInstanceDynamic::Create(GridMaterial, this);
+        GridMaterialInstance->SetTextureParameterValue(TEXT("CellStates"), CellStateTexture);
+        GridPlane->SetMaterial(0, GridMaterialInstance);
+    }
+
+    CellTexels.Init(GetCellStateColor(ECellState::Empty).ToFColor(false), GridWidth * GridHeight);
+    for (FColor& Texel : CellTexels)
+    {
+        Texel.A = 0;
+    }
+    DirtyCellRect = FIntRect(0, 0, GridWidth, GridHeight);
+    bCellVisualsDirty = true;
+    FlushCellVisuals();
+}
+
+void AGridManager::UpdateCellVisual(int32 X, int32 Y)
+{
+    if (!HasCellVisuals())
+        return;
+
+    FColor& Texel = CellTexels[Y * GridWidth + X];
+    const uint8 Highlight = Texel.A;
+    Texel = GetCellStateColor(GetCell(X, Y)->GetState()).ToFColor(false);
+    Texel.A = Highlight;
+    MarkCellVisualDirty(X, Y);
+}
+
+void AGridManager::MarkCellVisualDirty(int32 X, int32 Y)
+{
+    if (bCellVisualsDirty)
+    {
+        DirtyCellRect.Include(FIntPoint(X, Y));
+        DirtyCellRect.Include(FIntPoint(X + 1, Y + 1));
+        return;
+    }
+
+    DirtyCellRect = FIntRect(X, Y, X + 1, Y + 1);
+    bCellVisualsDirty = true;
+
+    // Tick only while there is something to upload
+    SetActorTickEnabled(true);
+}
+
+void AGridManager::Tick(float DeltaTime)
+{
+    Super::Tick(DeltaTime);
+    FlushCellVisuals();
+}
+
+void AGridManager::FlushCellVisuals()
+{
+    if (!bCellVisualsDirty || !CellStateTexture)
+        return;
+
+    bCellVisualsDirty = false;
+    SetActorTickEnabled(false);
+
+    // The upload happens later on the render thread, so it gets its own copy of the rectangle
+    const int32 RectWidth = DirtyCellRect.Width();
+    const int32 RectHeight = DirtyCellRect.Height();
+    FColor* RectTexels = new FColor[RectWidth * RectHeight];
+    for (int32 Row = 0; Row < RectHeight; ++Row)
+    {
+        FMemory::Memcpy(&RectTexels[Row * RectWidth], &CellTexels[(DirtyCellRect.Min.Y + Row) * GridWidth + DirtyCellRect.Min.X], RectWidth * sizeof(FColor));
+    }
+
+    FUpdateTextureRegion2D* Region = new FUpdateTextureRegion2D(DirtyCellRect.Min.X, DirtyCellRect.Min.Y, 0, 0, RectWidth, RectHeight);
+    CellStateTexture->UpdateTextureRegions(0, 1, Region, RectWidth * sizeof(FColor), sizeof(FColor), reinterpret_cast<uint8*>(RectTexels),
+        [](uint8* SrcData, const FUpdateTextureRegion2D* Regions)
+        {
+            delete[] reinterpret_cast<FColor*>(SrcData);
+            delete Regions;
+        });
 }
 
 void AGridManager::HighlightCell(int32 X, int32 Y, bool bHighlight)
 {
-    if (AGridCell* Cell = GetCell(X, Y))
+    if (IsValidGridPosition(X, Y) && HasCellVisuals())
     {
-        Cell->HighlightCell(bHighlight);
+        CellTexels[Y * GridWidth + X].A = bHighlight ? 255 : 0;
+        MarkCellVisualDirty(X, Y);
     }
 } 
\ No newline at end of file
@@ -5,6 +5,37 @@
 #include "GridCell.h"
 #include "GridManager.generated.h"
 
+class UMaterialInstanceDynamic;
+class UTexture2D;
+
+// A shape on the grid as one bitmask per row, bit I covering the cell I columns right of the origin.
+// At most 64 cells wide; bits at or past Width are ignored.
+struct FGridFootprint
+{
+    int32 Width = 0;
+    TArray<uint64, TInlineAllocator<8>> Rows;
+
+    int32 GetHeight() const { return Rows.Num(); }
+
+    static FGridFootprint MakeRect(int32 Width, int32 Height)
+    {
+        FGridFootprint Footprint;
+        Footprint.Width = FMath::Clamp(Width, 0, 64);
+        Footprint.Rows.Init(Footprint.Width == 64 ? ~uint64(0) : (uint64(1) << Footprint.Width) - 1, FMath::Max(Height, 0));
+        return Footprint;
+    }
+};
+
+// The building grid. Cells are a packed byte each, stored in 64x64 chunks that are only allocated once a cell in them
+// differs from the default and freed again when they all return to it, so memory follows the area actually in use
+// and a huge map costs nothing up front. Cells in unallocated chunks read as default.
+// Drawing them is a separate, optional layer: with GridPlaneMesh set, the whole grid is one plane whose material samples
+// a texture holding a texel per cell, RGB for the state colour and alpha for the highlight. Cell changes mark the
+// texture dirty and the touched rectangle is uploaded once on the next tick, however many cells changed.
+// The texture covers the whole grid, so leave the layer off for maps too large for one.
+// Rectangle availability queries use a summed-area table of unavailable cells kept in each chunk, plus a coarse one over
+// chunk totals, so they cost memory only where chunks are allocated. Both are brought up to date on the first query
+// after an edit, and only for the chunks it changed.
 UCLASS()
 class PROTOTYPE1_API AGridManager : public AActor
 {
@@ -14,25 +45,56 @@ public:
     AGridManager();
 
     virtual void BeginPlay() override;
+    virtual void Tick(float DeltaTime) override;
 
     // Grid creation and management
     void CreateGrid(int32 Width, int32 Height, float CellSize);
-    AGridCell* GetCell(int32 X, int32 Y) const;
+
+    // Null off the grid. Only valid until the next cell edit, which may free the chunk it points into.
+    const FGridCell* GetCell(int32 X, int32 Y) const;
     bool IsValidGridPosition(int32 X, int32 Y) const;
-    
+
     // World to grid conversion
     FVector2D WorldToGrid(const FVector& WorldLocation) const;
     FVector GridToWorld(int32 X, int32 Y) const;
-    
+
     // Cell operations
     bool IsCellAvailable(int32 X, int32 Y) const;
     void SetCellState(int32 X, int32 Y, ECellState NewState);
+    void SetCellWalkable(int32 X, int32 Y, bool bWalkable);
+    void SetCellBuildable(int32 X, int32 Y, bool bBuildable);
     void HighlightCell(int32 X, int32 Y, bool bHighlight);
 
-    // Grid properties
-    UPROPERTY(EditAnywhere, Category = "Grid")
-    TSubclassOf<AGridCell> GridCellClass;
+    // Region operations work a chunk row at a time, 64 cells to a word, and return the bounds of the cells they actually
+    // changed (empty when nothing did). The flow field and visual layer are only updated for those cells.
+
+    // Set the state of every cell in Rect, max exclusive, clipped to the grid
+    FIntRect FillRegion(const FIntRect& Rect, ECellState NewState);
 
+    // Whether the footprint placed at Origin lies on the grid with every cell it covers available
+    bool IsFootprintAvailable(const FGridFootprint& Footprint, const FIntPoint& Origin) const;
+
+    // Set the state of the cells the footprint covers at Origin, clipped to the grid
+    FIntRect SetFootprintState(const FGridFootprint& Footprint, const FIntPoint& Origin, ECellState NewState);
+    FIntRect ClearFootprint(const FGridFootprint& Footprint, const FIntPoint& Origin) { return SetFootprintState(Footprint, Origin, ECellState::Empty); }
+
+    // Cells in Rect that are not available, clipped to the grid. Four lookups into the chunk totals for the chunks Rect
+    // covers entirely, and four into each chunk along its edges.
+    int32 CountUnavailableCells(const FIntRect& Rect) const;
+
+    // Whether Rect is non-empty, on the grid and entirely available
+    bool IsRegionAvailable(const FIntRect& Rect) const;
+
+    // Every origin at which a Size footprint fits inside SearchArea with all its cells available, row by row.
+    // Linear in the area searched, each origin costing a CountUnavailableCells.
+    void FindRegionPlacements(const FIntRect& SearchArea, const FIntPoint& Size, TArray<FIntPoint>& OutOrigins) const;
+
+    // Flow field cost of stepping into a cell in the given state; anything not walkable and empty is impassable
+    static uint8 GetTraversalCost(ECellState State, bool bWalkable);
+
+    int32 GetNumAllocatedChunks() const { return NumAllocatedChunks; }
+
+    // Grid properties
     UPROPERTY(EditAnywhere, Category = "Grid")
     int32 GridWidth;
 
@@ -42,8 +104,108 @@ public:
     UPROPERTY(EditAnywhere, Category = "Grid")
     float CellSize;
 
+    // Visual layer; leave the mesh unset to draw nothing. A 100x100 plane centred on its origin, stretched over the grid.
+    UPROPERTY(EditAnywhere, Category = "Grid|Visuals")
+    UStaticMesh* GridPlaneMesh;
+
+    // Samples the cell texture from its "CellStates" texture parameter, with the plane's UVs covering the whole grid
+    UPROPERTY(EditAnywhere, Category = "Grid|Visuals")
+    UMaterialInterface* GridMaterial;
+
+protected:
+    UPROPERTY(VisibleAnywhere, Category = "Grid|Visuals")
+    UStaticMeshComponent* GridPlane;
+
 private:
-    // Grid data
-    UPROPERTY()
-    TArray<AGridCell*> GridCells;
+    static constexpr int32 ChunkShift = 6;
+    static constexpr int32 ChunkSize = 1 << ChunkShift;
+
+    static_assert(ChunkSize == 64, "Chunk rows are handled as one 64-bit word");
+
+    struct FGridChunk
+    {
+        FGridCell Cells[ChunkSize * ChunkSize];
+
+        // Bit per cell, set while IsAvailable(), so footprint tests are a mask per row
+        uint64 AvailableRows[ChunkSize];
+
+        // Cells that differ from the default; the chunk is freed when this drops to zero
+        int32 NumNonDefault = 0;
+
+        // Unavailable cells, and the chunk's summed-area table of them: entry (X, Y) counts the cells up to and
+        // including it. The table is rebuilt from AvailableRows on the first query after bSumsDirty is set.
+        int32 NumUnavailable = 0;
+        mutable uint16 UnavailableSums[ChunkSize * ChunkSize];
+        mutable bool bSumsDirty = false;
+
+        FGridChunk()
+        {
+            FMemory::Memset(AvailableRows, 0xFF, sizeof(AvailableRows));
+            FMemory::Memzero(UnavailableSums, sizeof(UnavailableSums));
+        }
+    };
+
+    int32 GetChunkIndex(int32 X, int32 Y) const { return (Y >> ChunkShift) * NumChunksX + (X >> ChunkShift); }
+    int32 GetNumChunksY() const { return NumChunksX > 0 ? Chunks.Num() / NumChunksX : 0; }
+    static int32 GetIndexInChunk(int32 X, int32 Y) { return (Y & (ChunkSize - 1)) * ChunkSize + (X & (ChunkSize - 1)); }
+
+    // Bits of a row of chunk column ChunkX whose cells lie in [MinX, MaxX); zero for columns off the grid
+    static uint64 GetChunkColumnMask(int32 ChunkX, int32 MinX, int32 MaxX);
+
+    // Store a cell, allocating its chunk for a non-default cell and freeing it once the chunk is all default again
+    void WriteCell(int32 X, int32 Y, FGridCell NewCell);
+
+    // Set the state of the cells picked out by CellMask in row Y of chunk column ChunkX, returning the ones that changed
+    uint64 SetChunkRowState(int32 ChunkX, int32 Y, uint64 CellMask, ECellState NewState);
+    bool IsChunkRowAvailable(int32 ChunkX, int32 Y, uint64 CellMask) const;
+
+    // Note a change in the number of unavailable cells in a chunk, invalidating its table and the chunk totals from it on
+    void MarkAvailabilityDirty(FGridChunk& Chunk, int32 ChunkIndex, int32 UnavailableDelta);
+    void UpdateChunkTotals() const;
+    static void UpdateChunkSums(const FGridChunk& Chunk);
+
+    // Unavailable cells in a rectangle already clipped to the grid, with the chunk totals up to date
+    int32 CountUnavailableInRect(const FIntRect& Rect) const;
+    static int32 CountUnavailableInChunk(const FGridChunk* Chunk, const FIntRect& LocalRect);
+
+    // Bring the flow field and visual layer up to date with the changed cells of a chunk row, bit 0 being cell (MinX, Y)
+    void UpdateChangedCells(int32 MinX, int32 Y, uint64 Changed);
+
+    // Align the flow field grid with this one and push every cell's cost into it
+    void SyncFlowFieldCosts();
+    void UpdateFlowFieldCost(int32 X, int32 Y, uint8 Cost);
+    void UpdateFlowFieldCost(const FIntRect& Cells, uint8 Cost);
+
+    // Create the cell texture and stretch the plane over the grid
+    void RebuildCellVisuals();
+    bool HasCellVisuals() const { return CellStateTexture != nullptr; }
+
+    // Set a cell's state colour, keeping its highlight
+    void UpdateCellVisual(int32 X, int32 Y);
+    void MarkCellVisualDirty(int32 X, int32 Y);
+
+    // Upload the dirty rectangle of CellTexels to the texture
+    void FlushCellVisuals();
+
+    // Grid data, chunk by chunk in rows; null for chunks with nothing but default cells
+    TArray<TUniquePtr<FGridChunk>> Chunks;
+    int32 NumChunksX;
+    int32 NumAllocatedChunks;
+
+    // Unavailable cells in the chunks above and left of each chunk corner, (NumChunksX + 1) to a row. Everything from
+    // ChunkTotalsDirtyMin down and right is stale while bChunkTotalsDirty is set.
+    mutable TArray<int32> ChunkUnavailableSums;
+    mutable FIntPoint ChunkTotalsDirtyMin;
+    mutable bool bChunkTotalsDirty;
+
+    // Visual layer state; texels are kept here and copied to the texture a rectangle at a time
+    UPROPERTY(Transient)
+    UTexture2D* CellStateTexture;
+
+    UPROPERTY(Transient)
+    UMaterialInstanceDynamic* GridMaterialInstance;
+
+    TArray<FColor> CellTexels;
+    FIntRect DirtyCellRect;
+    bool bCellVisualsDirty;
 }; 
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include "OrcaSolver.h"
+
+static constexpr double OrcaEpsilon = 1.0e-5;
+
+// Determinant of the 2x2 matrix with rows A and B; positive when B is counter-clockwise of A
+static FORCEINLINE double Det(const FVector2D& A, const FVector2D& B)
+{
+    return A.X * B.Y - A.Y * B.X;
+}
+
+FVector2D FOrcaSolver::ComputeVelocity(const FOrcaAgent& Agent, const FVector2D& PreferredVelocity, float MaxSpeed,
+    TArrayView<const FOrcaAgent> Neighbors, float TimeHorizon, float DeltaTime)
+{
+    const double InvTimeHorizon = 1.0 / FMath::Max(TimeHorizon, UE_KINDA_SMALL_NUMBER);
+    const double InvDeltaTime = 1.0 / FMath::Max(DeltaTime, UE_KINDA_SMALL_NUMBER);
+
+    FLineArray Lines;
+    for (const FOrcaAgent& Other : Neighbors)
+    {
+        const FVector2D RelativePosition = Other.Position - Agent.Position;
+        const FVector2D RelativeVelocity = Agent.Velocity - Other.Velocity;
+        const double DistSquared = RelativePosition.SizeSquared();
+        const double CombinedRadius = Agent.Radius + Other.Radius;
+        const double CombinedRadiusSquared = FMath::Square(CombinedRadius);
+
+        FLine Line;
+        FVector2D U;
+
+        if (DistSquared > CombinedRadiusSquared)
+        {
+            // Not touching. W is the relative velocity seen from the centre of the truncated cone's cutoff circle.
+            const FVector2D W = RelativeVelocity - InvTimeHorizon * RelativePosition;
+            const double WLengthSquared = W.SizeSquared();
+            const double Dot = W | RelativePosition;
+
+            if (Dot < 0.0 && FMath::Square(Dot) > CombinedRadiusSquared * WLengthSquared)
+            {
+                // Closest to the cutoff circle
+                const double WLength = FMath::Sqrt(WLengthSquared);
+                const FVector2D UnitW = W / WLength;
+                Line.Direction = FVector2D(UnitW.Y, -UnitW.X);
+                U = (CombinedRadius * InvTimeHorizon - WLength) * UnitW;
+            }
+            else
+            {
+                // Closest to one of the cone's legs
+                const double Leg = FMath::Sqrt(DistSquared - CombinedRadiusSquared);
+                if (Det(RelativePosition, W) > 0.0)
+                {
+                    Line.Direction = FVector2D(RelativePosition.X * Leg - RelativePosition.Y * CombinedRadius, RelativePosition.X * CombinedRadius + RelativePosition.Y * Leg) / DistSquared;
+                }
+                else
+                {
+                    Line.Direction = -FVector2D(RelativePosition.X * Leg + RelativePosition.Y * CombinedRadius, -RelativePosition.X * CombinedRadius + RelativePosition.Y * Leg) / DistSquared;
+                }
+                U = (RelativeVelocity | Line.Direction) * Line.Direction - RelativeVelocity;
+            }
+        }
+        else
+        {
+            // Already overlapping, so push apart within this step rather than over the time horizon
+            const FVector2D W = RelativeVelocity - InvDeltaTime * RelativePosition;
+            const double WLength = W.Size();
+            const FVector2D UnitW = WLength > OrcaEpsilon ? W / WLength : FVector2D(1.0, 0.0);
+            Line.Direction = FVector2D(UnitW.Y, -UnitW.X);
+            U = (CombinedRadius * InvDeltaTime - WLength) * UnitW;
+        }
+
+        // Take half the change when the other side is doing the same, all of it otherwise
+        Line.Point = Agent.Velocity + (Other.bReciprocal ? 0.5 : 1.0) * U;
+        Lines.Add(Line);
+    }
+
+    FVector2D Result;
+    const int32 FailedLine = LinearProgram2(Lines, MaxSpeed, PreferredVelocity, false, Result);
+    if (FailedLine < Lines.Num())
+    {
+        LinearProgram3(Lines, FailedLine, MaxSpeed, Result);
+    }
+    return Result;
+}
+
+bool FOrcaSolver::LinearProgram1(TArrayView<const FLine> Lines, int32 LineIndex, float Radius, const FVector2D& OptVelocity, bool bDirectionOpt, FVector2D& Result)
+{
+    const FLine& Line = Lines[LineIndex];
+
+    // Where the line crosses the speed circle
+    const double Dot = Line.Point | Line.Direction;
+    const double Discriminant = FMath::Square(Dot) + FMath::Square(Radius) - Line.Point.SizeSquared();
+    if (Discriminant < 0.0)
+        return false;
+
+    const double SqrtDiscriminant = FMath::Sqrt(Discriminant);
+    double TLeft = -Dot - SqrtDiscriminant;
+    double TRight = -Dot + SqrtDiscriminant;
+
+    // Clip that segment by every earlier line
+    for (int32 Index = 0; Index < LineIndex; ++Index)
+    {
+        const double Denominator = Det(Line.Direction, Lines[Index].Direction);
+        const double Numerator = Det(Lines[Index].Direction, Line.Point - Lines[Index].Point);
+
+        if (FMath::Abs(Denominator) <= OrcaEpsilon)
+        {
+            // Parallel; either this line is entirely allowed by the other one or entirely ruled out
+            if (Numerator < 0.0)
+                return false;
+            continue;
+        }
+
+        const double T = Numerator / Denominator;
+        if (Denominator >= 0.0)
+        {
+            TRight = FMath::Min(TRight, T);
+        }
+        else
+        {
+            TLeft = FMath::Max(TLeft, T);
+        }
+
+        if (TLeft > TRight)
+            return false;
+    }
+
+    if (bDirectionOpt)
+    {
+        // Furthest along OptVelocity
+        Result = Line.Point + ((OptVelocity | Line.Direction) > 0.0 ? TRight : TLeft) * Line.Direction;
+    }
+    else
+    {
+        // Closest to OptVelocity
+        const double T = Line.Direction | (OptVelocity - Line.Point);
+        Result = Line.Point + FMath::Clamp(T, TLeft, TRight) * Line.Direction;
+    }
+    return true;
+}
+
+int32 FOrcaSolver::LinearProgram2(TArrayView<const FLine> Lines, float Radius, const FVector2D& OptVelocity, bool bDirectionOpt, FVector2D& Result)
+{
+    if (bDirectionOpt)
+    {
+        // OptVelocity is a unit direction here
+        Result = OptVelocity * Radius;
+    }
+    else if (OptVelocity.SizeSquared() > FMath::Square(Radius))
+    {
+        Result = OptVelocity.GetSafeNormal() * Radius;
+    }
+    else
+    {
+        Result = OptVelocity;
+    }
+
+    // Incremental: the result only moves when a line rules it out, and then it moves onto that line
+    for (int32 Index = 0; Index < Lines.Num(); ++Index)
+    {
+        if (Det(Lines[Index].Direction, Lines[Index].Point - Result) > 0.0)
+        {
+            const FVector2D PreviousResult = Result;
+            if (!LinearProgram1(Lines, Index, Radius, OptVelocity, bDirectionOpt, Result))
+            {
+                Result = PreviousResult;
+                return Index;
+            }
+        }
+    }
+    return Lines.Num();
+}
+
+void FOrcaSolver::LinearProgram3(TArrayView<const FLine> Lines, int32 BeginLine, float Radius, FVector2D& Result)
+{
+    // No velocity satisfies every line, so minimise the furthest any line is violated
+    double Distance = 0.0;
+
+    for (int32 Index = BeginLine; Index < Lines.Num(); ++Index)
+    {
+        if (Det(Lines[Index].Direction, Lines[Index].Point - Result) <= Distance)
+            continue;
+
+        // Project the earlier lines onto this one
+        FLineArray ProjectedLines;
+        for (int32 Earlier = 0; Earlier < Index; ++Earlier)
+        {
+            FLine ProjectedLine;
+            const double Determinant = Det(Lines[Index].Direction, Lines[Earlier].Direction);
+
+            if (FMath::Abs(Determinant) <= OrcaEpsilon)
+            {
+                // Parallel lines pointing the same way add nothing
+                if ((Lines[Index].Direction | Lines[Earlier].Direction) > 0.0)
+                    continue;
+
+                ProjectedLine.Point = 0.5 * (Lines[Index].Point + Lines[Earlier].Point);
+            }
+            else
+            {
+                ProjectedLine.Point = Lines[Index].Point + (Det(Lines[Earlier].Direction, Lines[Index].Point - Lines[Earlier].Point) / Determinant) * Lines[Index].Direction;
+            }
+
+            ProjectedLine.Direction = (Lines[Earlier].Direction - Lines[Index].Direction).GetSafeNormal();
+            ProjectedLines.Add(ProjectedLine);
+        }
+
+        const FVector2D PreviousResult = Result;
+        if (LinearProgram2(ProjectedLines, Radius, FVector2D(-Lines[Index].Direction.Y, Lines[Index].Direction.X), true, Result) < ProjectedLines.Num())
+        {
+            // Can only fail through rounding; the previous result is the best there is
+            Result = PreviousResult;
+        }
+
+        Distance = Det(Lines[Index].Direction, Lines[Index].Point - Result);
+    }
+}
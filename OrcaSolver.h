@@ -0,0 +1,42 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// An agent as the ORCA solver sees it, on the XY plane
+struct FOrcaAgent
+{
+    FVector2D Position;
+    FVector2D Velocity;
+    float Radius;
+
+    // Whether this agent is solving ORCA too and will take its half of every avoidance.
+    // Agents that won't move aside are avoided entirely by the other side.
+    bool bReciprocal;
+};
+
+// Optimal reciprocal collision avoidance (van den Berg et al., "Reciprocal n-Body Collision Avoidance").
+// Each neighbour rules out a half-plane of velocities that would collide with it within the time horizon,
+// and a small linear program picks the allowed velocity closest to the preferred one.
+// No static obstacles; those are left to whatever moves the agent.
+class PROTOTYPE1_API FOrcaSolver
+{
+public:
+    // Velocity closest to PreferredVelocity, no faster than MaxSpeed, that stays clear of every neighbour for TimeHorizon
+    // seconds. If the agents are packed too tightly for that, the one that intrudes least into the half-planes is returned.
+    static FVector2D ComputeVelocity(const FOrcaAgent& Agent, const FVector2D& PreferredVelocity, float MaxSpeed,
+        TArrayView<const FOrcaAgent> Neighbors, float TimeHorizon, float DeltaTime);
+
+private:
+    // Velocities on the left of Direction through Point are allowed
+    struct FLine
+    {
+        FVector2D Point;
+        FVector2D Direction;
+    };
+
+    using FLineArray = TArray<FLine, TInlineAllocator<16>>;
+
+    static bool LinearProgram1(TArrayView<const FLine> Lines, int32 LineIndex, float Radius, const FVector2D& OptVelocity, bool bDirectionOpt, FVector2D& Result);
+    static int32 LinearProgram2(TArrayView<const FLine> Lines, float Radius, const FVector2D& OptVelocity, bool bDirectionOpt, FVector2D& Result);
+    static void LinearProgram3(TArrayView<const FLine> Lines, int32 BeginLine, float Radius, FVector2D& Result);
+};
@@ -1,4 +1,5 @@
 #include "RTS_PlayerController.h"
+#include "GridManager.h"
 #include "Kismet/GameplayStatics.h"
 #include "Engine/Canvas.h"
 #include "DrawDebugHelpers.h"
@@ -35,6 +36,15 @@ void ARTS_PlayerController::BeginPlay()
         UnitController = GetWorld()->SpawnActor<AUnitController>(AUnitController::StaticClass(), FVector::ZeroVector, FRotator::ZeroRotator, SpawnParams);
     }
 
+    // The grid manager is optional; without one placed buildings just don't mark cells
+    TArray<AActor*> FoundGridManagers;
+    UGameplayStatics::GetAllActorsOfClass(GetWorld(), AGridManager::StaticClass(), FoundGridManagers);
+
+    if (FoundGridManagers.Num() > 0)
+    {
+        GridManager = Cast<AGridManager>(FoundGridManagers[0]);
+    }
+
     // Setup Enhanced Input
     if (UEnhancedInputLocalPlayerSubsystem* Subsystem = ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(GetLocalPlayer()))
     {
@@ -180,7 +190,7 @@ void ARTS_PlayerController::UpdateBuildingPreview()
         WorldLocation.Y = FMath::RoundToFloat(WorldLocation.Y / GridSize) * GridSize;
 
         CurrentBuilding->SetActorLocation(WorldLocation);
-        CurrentBuilding->UpdatePlacementValidation(WorldLocation);
+        CurrentBuilding->UpdatePlacementValidation(WorldLocation, IsBuildingFootprintAvailable(CurrentBuilding));
     }
 }
 
@@ -196,7 +206,7 @@ void ARTS_PlayerController::TryPlaceBuilding()
         WorldLocation.Y = FMath::RoundToFloat(WorldLocation.Y / GridSize) * GridSize;
 
         CurrentBuilding->SetActorLocation(WorldLocation);
-        if (CurrentBuilding->CanBePlaced())
+        if (CurrentBuilding->CanBePlaced() && IsBuildingFootprintAvailable(CurrentBuilding))
         {
             // Finalize building placement
             CurrentBuilding->OnPlaced();
@@ -210,11 +220,39 @@ void ARTS_PlayerController::TryPlaceBuilding()
             if (PlacedBuilding)
             {
                 PlacedBuilding->BuildingMesh->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+                MarkBuildingFootprint(PlacedBuilding);
             }
         }
     }
 }
 
+void ARTS_PlayerController::MarkBuildingFootprint(ABuilding* Building)
+{
+    if (!GridManager || !Building)
+        return;
+
+    GridManager->FillRegion(GetBuildingCellRect(Building), ECellState::Occupied);
+}
+
+bool ARTS_PlayerController::IsBuildingFootprintAvailable(ABuilding* Building) const
+{
+    if (!GridManager || !Building)
+        return true;
+
+    // Answered from the grid's summed-area tables, so this is cheap enough to run every preview tick
+    return GridManager->IsRegionAvailable(GetBuildingCellRect(Building));
+}
+
+FIntRect ARTS_PlayerController::GetBuildingCellRect(ABuilding* Building) const
+{
+    // Every cell the building's bounds overlap, shrunk slightly so a building exactly one cell wide doesn't spill into the next
+    const FBox Bounds = Building->GetComponentsBoundingBox(true);
+    const FVector2D MinCell = GridManager->WorldToGrid(Bounds.Min);
+    const FVector2D MaxCell = GridManager->WorldToGrid(Bounds.Max - FVector(KINDA_SMALL_NUMBER));
+
+    return FIntRect(int32(MinCell.X), int32(MinCell.Y), int32(MaxCell.X) + 1, int32(MaxCell.Y) + 1);
+}
+
 void ARTS_PlayerController::CancelBuildingPlacement()
 {
     if (CurrentBuilding)
@@ -74,10 +74,22 @@ protected:
 
     void UpdateBuildingPreview();
 
+    // Mark the grid cells under a placed building as occupied
+    void MarkBuildingFootprint(ABuilding* Building);
+
+    // Whether every grid cell under the building is free; always true without a grid manager
+    bool IsBuildingFootprintAvailable(ABuilding* Building) const;
+
+    // The grid cells the building's bounds overlap, max exclusive
+    FIntRect GetBuildingCellRect(ABuilding* Building) const;
+
 private:
     UPROPERTY()
     class AUnitController* UnitController;
 
+    UPROPERTY()
+    class AGridManager* GridManager;
+
     // Building placement state
     UPROPERTY()
     ABuilding* CurrentBuilding;
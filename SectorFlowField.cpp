@@ -0,0 +1,534 @@
+#include "SectorFlowField.h"
+#include "Misc/ScopeRWLock.h"
+
+FFlowFieldSectorGraph::FFlowFieldSectorGraph(const FFlowFieldSectorGraph& Other)
+    : Layout(Other.Layout)
+    , CostField(Other.CostField)
+    , SectorSize(Other.SectorSize)
+    , SectorsX(Other.SectorsX)
+    , SectorsY(Other.SectorsY)
+    , Nodes(Other.Nodes)
+    , Portals(Other.Portals)
+    , SectorNodes(Other.SectorNodes)
+    , SectorPortals(Other.SectorPortals)
+    , EdgePortals(Other.EdgePortals)
+{
+    // Workers may be linking sectors of the original while it is copied
+    FReadScopeLock ReadLock(Other.SectorLinksLock);
+    SectorLinks = Other.SectorLinks;
+}
+
+void FFlowFieldSectorGraph::Build(const FFlowFieldLayout& InLayout, int32 InSectorSize, TSharedPtr<const FFlowFieldCostField> InCostField)
+{
+    Layout = InLayout;
+    CostField = MoveTemp(InCostField);
+    SectorSize = FMath::Max(InSectorSize, 1);
+    SectorsX = FMath::DivideAndRoundUp(Layout.Width, SectorSize);
+    SectorsY = FMath::DivideAndRoundUp(Layout.Height, SectorSize);
+
+    Nodes.Reset();
+    Portals.Reset();
+    SectorNodes.Reset();
+    SectorNodes.SetNum(GetNumSectors());
+    SectorPortals.Reset();
+    SectorPortals.SetNum(GetNumSectors());
+    EdgePortals.Reset();
+    EdgePortals.SetNum(GetNumSectors() * 2);
+    SectorLinks.Reset();
+    SectorLinks.SetNum(GetNumSectors());
+
+    for (int32 SectorY = 0; SectorY < SectorsY; ++SectorY)
+    {
+        for (int32 SectorX = 0; SectorX < SectorsX; ++SectorX)
+        {
+            const int32 Sector = SectorY * SectorsX + SectorX;
+
+            if (SectorX + 1 < SectorsX)
+            {
+                BuildEdgePortals(Sector * 2);
+            }
+
+            if (SectorY + 1 < SectorsY)
+            {
+                BuildEdgePortals(Sector * 2 + 1);
+            }
+        }
+    }
+}
+
+void FFlowFieldSectorGraph::Rebuild(TSharedPtr<const FFlowFieldCostField> InCostField, TArrayView<const FIntPoint> ChangedCells)
+{
+    CostField = MoveTemp(InCostField);
+
+    TSet<int32> DirtySectors;
+    TSet<int32> DirtyEdgeSlots;
+
+    for (const FIntPoint& Cell : ChangedCells)
+    {
+        if (!Layout.IsValidCell(Cell))
+            continue;
+
+        const int32 Sector = CellToSector(Cell);
+        const int32 SectorX = Sector % SectorsX;
+        const int32 SectorY = Sector / SectorsX;
+        const FIntRect Rect = GetSectorRect(Sector);
+
+        // Any cell can change distances inside its sector, but only cells on the rim can change portals and crossing costs
+        DirtySectors.Add(Sector);
+
+        if (Cell.X == Rect.Max.X - 1 && SectorX + 1 < SectorsX)
+        {
+            DirtyEdgeSlots.Add(Sector * 2);
+        }
+        if (Cell.X == Rect.Min.X && SectorX > 0)
+        {
+            DirtyEdgeSlots.Add((Sector - 1) * 2);
+        }
+        if (Cell.Y == Rect.Max.Y - 1 && SectorY + 1 < SectorsY)
+        {
+            DirtyEdgeSlots.Add(Sector * 2 + 1);
+        }
+        if (Cell.Y == Rect.Min.Y && SectorY > 0)
+        {
+            DirtyEdgeSlots.Add((Sector - SectorsX) * 2 + 1);
+        }
+    }
+
+    for (int32 EdgeSlot : DirtyEdgeSlots)
+    {
+        RemoveEdgePortals(EdgeSlot);
+        BuildEdgePortals(EdgeSlot);
+
+        // Both sides lost and gained nodes
+        DirtySectors.Add(EdgeSlot / 2);
+        DirtySectors.Add(GetEdgeSlotNeighbor(EdgeSlot));
+    }
+
+    // Relinked when next searched. This copy isn't shared yet, so no lock is needed.
+    for (int32 Sector : DirtySectors)
+    {
+        SectorLinks[Sector].Reset();
+    }
+}
+
+FIntRect FFlowFieldSectorGraph::GetSectorRect(int32 Sector) const
+{
+    const FIntPoint Min((Sector % SectorsX) * SectorSize, (Sector / SectorsX) * SectorSize);
+    const FIntPoint Max(FMath::Min(Min.X + SectorSize, Layout.Width), FMath::Min(Min.Y + SectorSize, Layout.Height));
+    return FIntRect(Min, Max);
+}
+
+void FFlowFieldSectorGraph::BuildEdgePortals(int32 EdgeSlot)
+{
+    const FIntRect Rect = GetSectorRect(EdgeSlot / 2);
+    const bool bAlongX = EdgeSlot % 2 == 0;
+
+    // Walk the last row or column of the sector, pairing each cell with the one across the edge
+    const FIntPoint RunStep = bAlongX ? FIntPoint(0, 1) : FIntPoint(1, 0);
+    const FIntPoint Across = bAlongX ? FIntPoint(1, 0) : FIntPoint(0, 1);
+    const FIntPoint EdgeStart = bAlongX ? FIntPoint(Rect.Max.X - 1, Rect.Min.Y) : FIntPoint(Rect.Min.X, Rect.Max.Y - 1);
+    const int32 EdgeLength = bAlongX ? Rect.Height() : Rect.Width();
+
+    // Every unbroken stretch of pairs that are passable on both sides becomes its own portal
+    int32 RunStart = INDEX_NONE;
+    for (int32 Step = 0; Step <= EdgeLength; ++Step)
+    {
+        const FIntPoint Cell = EdgeStart + RunStep * Step;
+        const bool bOpen = Step < EdgeLength && !IsBlocked(Cell) && !IsBlocked(Cell + Across);
+
+        if (bOpen && RunStart == INDEX_NONE)
+        {
+            RunStart = Step;
+        }
+        else if (!bOpen && RunStart != INDEX_NONE)
+        {
+            const FIntPoint RunStartA = EdgeStart + RunStep * RunStart;
+            AddPortal(EdgeSlot, RunStartA, RunStartA + Across, RunStep, Step - RunStart);
+            RunStart = INDEX_NONE;
+        }
+    }
+}
+
+void FFlowFieldSectorGraph::RemoveEdgePortals(int32 EdgeSlot)
+{
+    for (int32 PortalIndex : EdgePortals[EdgeSlot])
+    {
+        const FPortal& Portal = Portals[PortalIndex];
+        for (int32 Node : { Portal.NodeA, Portal.NodeB })
+        {
+            const int32 Sector = Nodes[Node].Sector;
+            SectorNodes[Sector].Remove(Node);
+            SectorPortals[Sector].Remove(PortalIndex);
+            Nodes.RemoveAt(Node);
+        }
+        Portals.RemoveAt(PortalIndex);
+    }
+    EdgePortals[EdgeSlot].Reset();
+}
+
+void FFlowFieldSectorGraph::AddPortal(int32 EdgeSlot, const FIntPoint& RunStartA, const FIntPoint& RunStartB, const FIntPoint& RunStep, int32 RunLength)
+{
+    const int32 SectorA = EdgeSlot / 2;
+    const int32 SectorB = GetEdgeSlotNeighbor(EdgeSlot);
+
+    FPortal Portal;
+    Portal.RunStartA = RunStartA;
+    Portal.RunStartB = RunStartB;
+    Portal.RunStep = RunStep;
+    Portal.RunLength = RunLength;
+    Portal.NodeOffset = RunLength / 2;
+    const int32 PortalIndex = Portals.Add(Portal);
+
+    // One node either side, in the middle of the run. Edges are filled in by LinkSectorNodes when first needed.
+    const int32 NodeA = Nodes.Add({ RunStartA + RunStep * Portal.NodeOffset, SectorA, PortalIndex });
+    const int32 NodeB = Nodes.Add({ RunStartB + RunStep * Portal.NodeOffset, SectorB, PortalIndex });
+    Portals[PortalIndex].NodeA = NodeA;
+    Portals[PortalIndex].NodeB = NodeB;
+
+    SectorNodes[SectorA].Add(NodeA);
+    SectorNodes[SectorB].Add(NodeB);
+    SectorPortals[SectorA].Add(PortalIndex);
+    SectorPortals[SectorB].Add(PortalIndex);
+    EdgePortals[EdgeSlot].Add(PortalIndex);
+}
+
+const TArray<FFlowFieldSectorGraph::FEdge>& FFlowFieldSectorGraph::GetEdges(int32 Node) const
+{
+    const int32 Sector = Nodes[Node].Sector;
+    return FindOrLinkSector(Sector).NodeEdges[SectorNodes[Sector].Find(Node)];
+}
+
+const FFlowFieldSectorGraph::FSectorLinks& FFlowFieldSectorGraph::FindOrLinkSector(int32 Sector) const
+{
+    {
+        FReadScopeLock ReadLock(SectorLinksLock);
+        if (const FSectorLinks* Links = SectorLinks[Sector].Get())
+            return *Links;
+    }
+
+    // Measured outside the lock so searches in other sectors carry on. Two threads may both link the same
+    // sector; the first to finish wins and the other's links are dropped.
+    TSharedRef<const FSectorLinks> NewLinks = LinkSectorNodes(Sector);
+
+    FWriteScopeLock WriteLock(SectorLinksLock);
+    if (!SectorLinks[Sector])
+    {
+        SectorLinks[Sector] = NewLinks;
+    }
+    return *SectorLinks[Sector];
+}
+
+TSharedRef<const FFlowFieldSectorGraph::FSectorLinks> FFlowFieldSectorGraph::LinkSectorNodes(int32 Sector) const
+{
+    const TArray<int32>& NodesInSector = SectorNodes[Sector];
+    TSharedRef<FSectorLinks> Links = MakeShared<FSectorLinks>();
+    Links->NodeEdges.SetNum(NodesInSector.Num());
+
+    // Crossing a portal is a single step into the node on the other side
+    for (int32 Index = 0; Index < NodesInSector.Num(); ++Index)
+    {
+        const int32 Node = NodesInSector[Index];
+        const FPortal& Portal = Portals[Nodes[Node].Portal];
+        const int32 OtherNode = Portal.NodeA == Node ? Portal.NodeB : Portal.NodeA;
+        Links->NodeEdges[Index].Add({ OtherNode, GetStepCost(Nodes[OtherNode].Cell) });
+    }
+
+    if (NodesInSector.Num() < 2)
+        return Links;
+
+    // Distances between nodes are measured inside the sector only; routes through
+    // neighbouring sectors are covered by the nodes there
+    const FIntRect Rect = GetSectorRect(Sector);
+    const FFlowFieldLayout SectorLayout = Layout.GetSubLayout(Rect);
+
+    for (int32 FromIndex = 0; FromIndex < NodesInSector.Num(); ++FromIndex)
+    {
+        FFlowField SectorField(SectorLayout, Nodes[NodesInSector[FromIndex]].Cell - Rect.Min, CostField);
+        SectorField.Build();
+
+        for (int32 ToNode : NodesInSector)
+        {
+            if (ToNode == NodesInSector[FromIndex])
+                continue;
+
+            const int32 Cost = SectorField.GetIntegratedCost(Nodes[ToNode].Cell - Rect.Min);
+            if (Cost != MAX_int32)
+            {
+                Links->NodeEdges[FromIndex].Add({ ToNode, Cost });
+            }
+        }
+    }
+    return Links;
+}
+
+SIZE_T FFlowFieldSectorGraph::GetAllocatedSize() const
+{
+    SIZE_T Size = sizeof(*this) + Nodes.GetAllocatedSize() + Portals.GetAllocatedSize();
+    Size += SectorNodes.GetAllocatedSize() + SectorPortals.GetAllocatedSize() + EdgePortals.GetAllocatedSize();
+    {
+        FReadScopeLock ReadLock(SectorLinksLock);
+        Size += SectorLinks.GetAllocatedSize();
+        for (const TSharedPtr<const FSectorLinks>& Links : SectorLinks)
+        {
+            if (Links)
+            {
+                Size += sizeof(FSectorLinks) + Links->NodeEdges.GetAllocatedSize();
+                for (const TArray<FEdge>& NodeEdges : Links->NodeEdges)
+                {
+                    Size += NodeEdges.GetAllocatedSize();
+                }
+            }
+        }
+    }
+    for (int32 Sector = 0; Sector < GetNumSectors(); ++Sector)
+    {
+        Size += SectorNodes[Sector].GetAllocatedSize() + SectorPortals[Sector].GetAllocatedSize();
+    }
+    for (const TArray<int32>& Slot : EdgePortals)
+    {
+        Size += Slot.GetAllocatedSize();
+    }
+    return Size;
+}
+
+FSectorFlowField::FSectorFlowField(TSharedRef<const FFlowFieldSectorGraph> InGraph, const FFlowFieldGoal& InGoal)
+    : Graph(InGraph)
+    , Goal(InGoal)
+    , AnchorCell(InGoal.GetAnchorCell())
+{
+}
+
+FSectorFlowField::~FSectorFlowField()
+{
+    for (int32 Sector = 0; Sector < SectorFields.Num(); ++Sector)
+    {
+        ResetSectorField(Sector);
+    }
+}
+
+void FSectorFlowField::Build()
+{
+    for (int32 Sector = 0; Sector < SectorFields.Num(); ++Sector)
+    {
+        ResetSectorField(Sector);
+    }
+
+    SectorFields.SetNum(Graph->GetNumSectors());
+    for (std::atomic<FFlowField*>& SectorField : SectorFields)
+    {
+        SectorField.store(nullptr, std::memory_order_relaxed);
+    }
+    SearchPortalGraph();
+}
+
+void FSectorFlowField::ResetSectorField(int32 Sector)
+{
+    delete SectorFields[Sector].exchange(nullptr, std::memory_order_relaxed);
+}
+
+void FSectorFlowField::SearchPortalGraph()
+{
+    const FFlowFieldLayout& Layout = Graph->GetLayout();
+
+    NodeCosts.Init(MAX_int32, Graph->GetMaxNodes());
+
+    struct FOpenNode
+    {
+        int32 Node;
+        int32 Cost;
+    };
+    auto CheaperFirst = [](const FOpenNode& A, const FOpenNode& B) { return A.Cost < B.Cost; };
+    TArray<FOpenNode> OpenSet;
+
+    // Nodes in sectors holding goal cells start at their in-sector distance to the nearest of them
+    TArray<int32> GoalSectors;
+    for (const FIntPoint& Cell : Goal.GetCells())
+    {
+        GoalSectors.AddUnique(Graph->CellToSector(Cell));
+    }
+
+    for (int32 GoalSector : GoalSectors)
+    {
+        const FIntRect GoalRect = Graph->GetSectorRect(GoalSector);
+        FFlowField GoalSectorField(Layout.GetSubLayout(GoalRect), AnchorCell - GoalRect.Min, Graph->GetCostField());
+        GoalSectorField.Build(Goal);
+
+        for (int32 Node : Graph->GetSectorNodes(GoalSector))
+        {
+            const int32 Cost = GoalSectorField.GetIntegratedCost(Graph->GetNode(Node).Cell - GoalRect.Min);
+            if (Cost < NodeCosts[Node])
+            {
+                NodeCosts[Node] = Cost;
+                OpenSet.HeapPush({ Node, Cost }, CheaperFirst);
+            }
+        }
+    }
+
+    // Dijkstra over the portal graph
+    while (OpenSet.Num() > 0)
+    {
+        FOpenNode Current;
+        OpenSet.HeapPop(Current, CheaperFirst, false);
+        if (Current.Cost > NodeCosts[Current.Node])
+            continue;
+
+        for (const FFlowFieldSectorGraph::FEdge& Edge : Graph->GetEdges(Current.Node))
+        {
+            const int32 NewCost = Current.Cost + Edge.Cost;
+            if (NewCost < NodeCosts[Edge.ToNode])
+            {
+                NodeCosts[Edge.ToNode] = NewCost;
+                OpenSet.HeapPush({ Edge.ToNode, NewCost }, CheaperFirst);
+            }
+        }
+    }
+}
+
+bool FSectorFlowField::ApplyChange(const FFlowFieldChange& Change)
+{
+    if (Change.SectorGraph)
+    {
+        Graph = Change.SectorGraph.ToSharedRef();
+    }
+
+    const TSharedPtr<const FFlowFieldCostField>& CostField = Graph->GetCostField();
+    if (CostField && !Goal.GetCells().ContainsByPredicate([&CostField](const FIntPoint& Cell) { return CostField->GetCost(Cell) != FFlowFieldCostField::Impassable; }))
+        return false;
+
+    const TArray<int32> OldNodeCosts = MoveTemp(NodeCosts);
+    SearchPortalGraph();
+
+    // A sector field covers its sector plus a one-cell ring, so a changed cell can reach the fields of every sector around it
+    const FFlowFieldLayout& Layout = Graph->GetLayout();
+    TBitArray<> StaleSectors(false, Graph->GetNumSectors());
+
+    for (const FIntPoint& Cell : Change.Cells)
+    {
+        for (int32 OffsetY = -1; OffsetY <= 1; ++OffsetY)
+        {
+            for (int32 OffsetX = -1; OffsetX <= 1; ++OffsetX)
+            {
+                const FIntPoint Neighbor = Cell + FIntPoint(OffsetX, OffsetY);
+                if (Layout.IsValidCell(Neighbor))
+                {
+                    StaleSectors[Graph->CellToSector(Neighbor)] = true;
+                }
+            }
+        }
+    }
+
+    // Sector fields are also seeded from the node costs across their portals
+    for (int32 Node = 0; Node < NodeCosts.Num(); ++Node)
+    {
+        const int32 OldCost = OldNodeCosts.IsValidIndex(Node) ? OldNodeCosts[Node] : MAX_int32;
+        if (!Graph->IsValidNode(Node) || NodeCosts[Node] == OldCost)
+            continue;
+
+        const FFlowFieldSectorGraph::FPortal& Portal = Graph->GetPortal(Graph->GetNode(Node).Portal);
+        StaleSectors[Graph->GetNode(Portal.NodeA).Sector] = true;
+        StaleSectors[Graph->GetNode(Portal.NodeB).Sector] = true;
+    }
+
+    for (int32 Sector = 0; Sector < SectorFields.Num(); ++Sector)
+    {
+        if (StaleSectors[Sector])
+        {
+            ResetSectorField(Sector);
+        }
+    }
+    return true;
+}
+
+const FFlowField* FSectorFlowField::FindOrBuildSectorField(int32 Sector) const
+{
+    if (!SectorFields.IsValidIndex(Sector))
+        return nullptr;
+
+    if (const FFlowField* Built = SectorFields[Sector].load(std::memory_order_acquire))
+        return Built;
+
+    // Another thread may have built it while we waited for the lock
+    FScopeLock BuildLock(&SectorBuildLock);
+    if (const FFlowField* Built = SectorFields[Sector].load(std::memory_order_relaxed))
+        return Built;
+
+    const FFlowFieldLayout& Layout = Graph->GetLayout();
+
+    // The sector plus a one-cell ring of its neighbours, so edge cells can flow out across portals
+    FIntRect Rect = Graph->GetSectorRect(Sector);
+    Rect.Min -= FIntPoint(1, 1);
+    Rect.Max += FIntPoint(1, 1);
+    Rect.Clip(FIntRect(0, 0, Layout.Width, Layout.Height));
+
+    TUniquePtr<FFlowField> SectorField = MakeUnique<FFlowField>(Layout.GetSubLayout(Rect), AnchorCell - Rect.Min, Graph->GetCostField());
+    const FFlowFieldLayout& SectorLayout = SectorField->GetLayout();
+
+    TArray<FFlowFieldSeed> Seeds;
+    for (const FIntPoint& Cell : Goal.GetCells())
+    {
+        if (Rect.Contains(Cell))
+        {
+            Seeds.Add({ SectorLayout.CellToIndex(Cell - Rect.Min), 0 });
+        }
+    }
+
+    // Seed the far side of each portal with the cost of its node, plus the walk along the run to reach it.
+    // The walk is counted as open ground; cheaper than integrating it and close enough at this scale.
+    for (int32 PortalIndex : Graph->GetSectorPortals(Sector))
+    {
+        const FFlowFieldSectorGraph::FPortal& Portal = Graph->GetPortal(PortalIndex);
+        const bool bSectorIsA = Graph->GetNode(Portal.NodeA).Sector == Sector;
+        const int32 FarNodeCost = NodeCosts[bSectorIsA ? Portal.NodeB : Portal.NodeA];
+        const FIntPoint FarRunStart = bSectorIsA ? Portal.RunStartB : Portal.RunStartA;
+
+        if (FarNodeCost == MAX_int32)
+            continue;
+
+        for (int32 Step = 0; Step < Portal.RunLength; ++Step)
+        {
+            const FIntPoint Cell = FarRunStart + Portal.RunStep * Step - Rect.Min;
+            Seeds.Add({ SectorLayout.CellToIndex(Cell), FarNodeCost + FMath::Abs(Step - Portal.NodeOffset) });
+        }
+    }
+
+    SectorField->Build(Seeds);
+
+    // Release so threads that see the pointer without taking the lock also see the finished field
+    FFlowField* Built = SectorField.Release();
+    SectorFields[Sector].store(Built, std::memory_order_release);
+    return Built;
+}
+
+FVector FSectorFlowField::GetFlowDirection(const FVector& WorldLocation) const
+{
+    const FIntPoint Cell = Graph->GetLayout().WorldToCell(WorldLocation);
+    if (!Graph->GetLayout().IsValidCell(Cell))
+        return FVector::ZeroVector;
+
+    const FFlowField* SectorField = FindOrBuildSectorField(Graph->CellToSector(Cell));
+    return SectorField ? SectorField->GetFlowDirection(WorldLocation) : FVector::ZeroVector;
+}
+
+SIZE_T FSectorFlowField::GetAllocatedSize() const
+{
+    SIZE_T Size = sizeof(*this) + NodeCosts.GetAllocatedSize() + SectorFields.GetAllocatedSize();
+    for (const std::atomic<FFlowField*>& SectorField : SectorFields)
+    {
+        if (const FFlowField* Built = SectorField.load(std::memory_order_acquire))
+        {
+            Size += Built->GetAllocatedSize();
+        }
+    }
+    return Size;
+}
+
+void FSectorFlowField::GatherBuiltFields(TArray<const FFlowField*>& OutFields) const
+{
+    for (const std::atomic<FFlowField*>& SectorField : SectorFields)
+    {
+        if (const FFlowField* Built = SectorField.load(std::memory_order_acquire))
+        {
+            OutFields.Add(Built);
+        }
+    }
+}
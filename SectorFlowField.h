@@ -0,0 +1,158 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FlowField.h"
+#include <atomic>
+
+// Coarse graph over fixed-size square sectors of the flow field grid.
+// Each open stretch of a shared sector edge is a portal with a node on either side.
+// Nodes are linked across their portal and to every other node they can reach in the same sector. Measuring those
+// in-sector distances takes a field build per node, so it's left until a search first asks for a sector's edges;
+// building or rebuilding the graph only cuts portals.
+class PROTOTYPE1_API FFlowFieldSectorGraph
+{
+public:
+    struct FNode
+    {
+        FIntPoint Cell;
+        int32 Sector;
+        int32 Portal;
+    };
+
+    struct FEdge
+    {
+        int32 ToNode;
+        int32 Cost;
+    };
+
+    // A run of cells along a sector edge, seen from each side
+    struct FPortal
+    {
+        int32 NodeA;
+        int32 NodeB;
+        FIntPoint RunStartA;
+        FIntPoint RunStartB;
+        FIntPoint RunStep;
+        int32 RunLength;
+
+        // Position of the node cells within the run
+        int32 NodeOffset;
+    };
+
+    FFlowFieldSectorGraph() = default;
+    FFlowFieldSectorGraph(const FFlowFieldSectorGraph& Other);
+
+    // Lay out sectors over the grid and build the portal graph
+    void Build(const FFlowFieldLayout& InLayout, int32 InSectorSize, TSharedPtr<const FFlowFieldCostField> InCostField);
+
+    // Switch to a new cost field snapshot and rebuild only the sectors holding ChangedCells.
+    // Portals are re-cut on the sector edges those cells lie on, and those sectors are linked again when next searched;
+    // every other node keeps its id and its edges.
+    void Rebuild(TSharedPtr<const FFlowFieldCostField> InCostField, TArrayView<const FIntPoint> ChangedCells);
+
+    const FFlowFieldLayout& GetLayout() const { return Layout; }
+    const TSharedPtr<const FFlowFieldCostField>& GetCostField() const { return CostField; }
+    int32 GetNumSectors() const { return SectorsX * SectorsY; }
+    int32 CellToSector(const FIntPoint& Cell) const { return (Cell.Y / SectorSize) * SectorsX + Cell.X / SectorSize; }
+
+    // Cells covered by a sector, max exclusive. Sectors on the far edges may be smaller.
+    FIntRect GetSectorRect(int32 Sector) const;
+
+    // Node ids are sparse once sectors have been rebuilt, so size per-node arrays by GetMaxNodes
+    int32 GetMaxNodes() const { return Nodes.GetMaxIndex(); }
+    bool IsValidNode(int32 Node) const { return Nodes.IsValidIndex(Node); }
+    const FNode& GetNode(int32 Node) const { return Nodes[Node]; }
+
+    // Edges out of a node, linking its sector on first use. Safe to call from several threads at once.
+    const TArray<FEdge>& GetEdges(int32 Node) const;
+
+    const TArray<int32>& GetSectorNodes(int32 Sector) const { return SectorNodes[Sector]; }
+    const TArray<int32>& GetSectorPortals(int32 Sector) const { return SectorPortals[Sector]; }
+    const FPortal& GetPortal(int32 Portal) const { return Portals[Portal]; }
+
+    SIZE_T GetAllocatedSize() const;
+
+private:
+    // Shared sector edges are numbered Sector * 2 for the edge with the next sector along X,
+    // and Sector * 2 + 1 for the edge with the next sector along Y
+    void BuildEdgePortals(int32 EdgeSlot);
+    void RemoveEdgePortals(int32 EdgeSlot);
+    int32 GetEdgeSlotNeighbor(int32 EdgeSlot) const { return EdgeSlot % 2 == 0 ? EdgeSlot / 2 + 1 : EdgeSlot / 2 + SectorsX; }
+
+    void AddPortal(int32 EdgeSlot, const FIntPoint& RunStartA, const FIntPoint& RunStartB, const FIntPoint& RunStep, int32 RunLength);
+
+    // Edges for each node of a sector, in SectorNodes order
+    struct FSectorLinks
+    {
+        TArray<TArray<FEdge>> NodeEdges;
+    };
+
+    const FSectorLinks& FindOrLinkSector(int32 Sector) const;
+    TSharedRef<const FSectorLinks> LinkSectorNodes(int32 Sector) const;
+
+    uint8 GetStepCost(const FIntPoint& Cell) const { return CostField ? CostField->GetCost(Cell) : FFlowFieldCostField::Open; }
+    bool IsBlocked(const FIntPoint& Cell) const { return GetStepCost(Cell) == FFlowFieldCostField::Impassable; }
+
+    FFlowFieldLayout Layout;
+    TSharedPtr<const FFlowFieldCostField> CostField;
+    int32 SectorSize = 0;
+    int32 SectorsX = 0;
+    int32 SectorsY = 0;
+
+    TSparseArray<FNode> Nodes;
+    TSparseArray<FPortal> Portals;
+    TArray<TArray<int32>> SectorNodes;
+    TArray<TArray<int32>> SectorPortals;
+    TArray<TArray<int32>> EdgePortals;
+
+    // Per-sector links, null until first asked for. Never changed once set, so copies of the graph share every
+    // sector they don't rebuild.
+    mutable TArray<TSharedPtr<const FSectorLinks>> SectorLinks;
+    mutable FRWLock SectorLinksLock;
+};
+
+// Hierarchical flow field towards a goal, either one cell or a whole area.
+// The portal graph is searched once when the field is built, which is cheap because it only has a few nodes per sector.
+// Per-sector fields are built the first time something samples that sector, so only the corridors units actually travel are paid for.
+class PROTOTYPE1_API FSectorFlowField : public IFlowField
+{
+public:
+    FSectorFlowField(TSharedRef<const FFlowFieldSectorGraph> InGraph, const FFlowFieldGoal& InGoal);
+    virtual ~FSectorFlowField() override;
+
+    // Search the portal graph outward from the goal
+    void Build();
+
+    // IFlowField
+    virtual FVector GetFlowDirection(const FVector& WorldLocation) const override;
+    virtual SIZE_T GetAllocatedSize() const override;
+    virtual void GatherBuiltFields(TArray<const FFlowField*>& OutFields) const override;
+
+    // Re-search the portal graph and drop the sector fields whose cells or portal costs changed
+    virtual bool ApplyChange(const FFlowFieldChange& Change) override;
+
+    // Get the field covering a sector, building it on first use. Safe to call from several threads at once.
+    const FFlowField* FindOrBuildSectorField(int32 Sector) const;
+
+private:
+    // Dijkstra from the goal over the portal graph, filling NodeCosts
+    void SearchPortalGraph();
+
+    // Free a built sector field; only while nothing is sampling this field
+    void ResetSectorField(int32 Sector);
+
+    TSharedRef<const FFlowFieldSectorGraph> Graph;
+    FFlowFieldGoal Goal;
+
+    // Goal cell units head straight for when no route reaches them
+    FIntPoint AnchorCell;
+
+    // Cost from each graph node to the nearest goal cell, MAX_int32 if unreachable
+    TArray<int32> NodeCosts;
+
+    // Sector fields built so far, indexed by sector and owned here. Mutable because sampling is what builds them,
+    // and units may sample from several steering threads at once: each slot is published atomically once its
+    // field is complete, and builds are serialised by SectorBuildLock so no sector is built twice.
+    mutable TArray<std::atomic<FFlowField*>> SectorFields;
+    mutable FCriticalSection SectorBuildLock;
+};
@@ -1,9 +1,11 @@
 #include "Unit.h"
-#include "Kismet/GameplayStatics.h"
+#include "CrowdSubsystem.h"
+#include "UnitRenderSubsystem.h"
 
 AUnit::AUnit()
 {
-    PrimaryActorTick.bCanEverTick = true;
+    // Moved by UCrowdSubsystem rather than ticking itself
+    PrimaryActorTick.bCanEverTick = false;
 
     // Create and setup the unit mesh
     UnitMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("UnitMesh"));
@@ -16,159 +18,168 @@ AUnit::AUnit()
     UnitMesh->SetCollisionResponseToChannel(ECollisionChannel::ECC_Camera, ECollisionResponse::ECR_Ignore);
     UnitMesh->SetCollisionResponseToChannel(ECollisionChannel::ECC_Pawn, ECollisionResponse::ECR_Overlap);
     
-    // Create movement component
-    MovementComponent = CreateDefaultSubobject<UFloatingPawnMovement>(TEXT("MovementComponent"));
-    MovementComponent->UpdatedComponent = RootComponent;
-    
     // Set movement parameters for smoother movement
     MovementSpeed = 400.0f;  // Increased base speed
     RotationSpeed = 8.0f;    // Slightly reduced for smoother rotation
     AcceptanceRadius = 50.0f;
     AvoidanceRadius = 150.0f;  // Reduced to prevent units from spreading too much
-    
-    MovementComponent->MaxSpeed = MovementSpeed;
-    MovementComponent->Acceleration = MovementSpeed * 2;  // Reduced for smoother acceleration
-    MovementComponent->Deceleration = MovementSpeed * 2;  // Reduced for smoother deceleration
-    MovementComponent->bConstrainToPlane = true;
-    MovementComponent->SetPlaneConstraintNormal(FVector(0, 0, 1));
-
-    // Initialize variables
-    bIsMoving = false;
-    TargetDestination = FVector::ZeroVector;
-    StuckTime = 0.0f;
-    LastLocation = FVector::ZeroVector;
+    AvoidanceMode = EUnitAvoidanceMode::Steering;
+    MovementMode = EUnitMovementMode::Swept;
+    bRenderInstanced = false;
+    TeamColor = FLinearColor::White;
+
+    CrowdIndex = INDEX_NONE;
+    RenderBatch = INDEX_NONE;
+    RenderInstance = INDEX_NONE;
+    bInPool = false;
 }
 
 void AUnit::BeginPlay()
 {
     Super::BeginPlay();
-    LastLocation = GetActorLocation();
 
     // Store the default material
     if (UnitMesh && UnitMesh->GetMaterial(0))
     {
         DefaultMaterial = UnitMesh->GetMaterial(0);
     }
+
+    // ORCA keeps units apart by itself, so pawn overlaps would only cost physics work
+    if (UnitMesh && AvoidanceMode == EUnitAvoidanceMode::Orca)
+    {
+        UnitMesh->SetCollisionResponseToChannel(ECollisionChannel::ECC_Pawn, ECollisionResponse::ECR_Ignore);
+        UnitMesh->SetGenerateOverlapEvents(false);
+    }
+
+    // Kinematic units are never swept or pushed, so they only need to answer traces
+    if (UnitMesh && MovementMode == EUnitMovementMode::Kinematic)
+    {
+        UnitMesh->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+        UnitMesh->SetCollisionResponseToChannel(ECollisionChannel::ECC_Pawn, ECollisionResponse::ECR_Ignore);
+        UnitMesh->SetGenerateOverlapEvents(false);
+    }
+
+    // Units spawned into the pool wait there until acquired
+    if (!bInPool)
+    {
+        ActivateUnit();
+    }
 }
 
-void AUnit::SetSelected(bool bSelected)
+void AUnit::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-    if (!UnitMesh) return;
+    if (UCrowdSubsystem* Crowd = GetCrowd())
+    {
+        Crowd->UnregisterUnit(this);
+    }
+    if (UUnitRenderSubsystem* Renderer = GetRenderer())
+    {
+        Renderer->RemoveUnit(this);
+    }
+    Super::EndPlay(EndPlayReason);
+}
 
-    if (bSelected)
+void AUnit::ActivateUnit()
+{
+    bInPool = false;
+    SetActorHiddenInGame(false);
+    SetActorEnableCollision(true);
+
+    // Hidden, but still there for collision, sweeps and selection traces
+    UUnitRenderSubsystem* Renderer = GetRenderer();
+    if (bRenderInstanced && Renderer)
     {
-        if (SelectedMaterial)
+        Renderer->AddUnit(this);
+        if (RenderBatch != INDEX_NONE)
         {
-            UnitMesh->SetMaterial(0, SelectedMaterial);
+            UnitMesh->SetVisibility(false);
         }
     }
-    else
+
+    if (UCrowdSubsystem* Crowd = GetCrowd())
     {
-        if (DefaultMaterial)
-        {
-            UnitMesh->SetMaterial(0, DefaultMaterial);
-        }
+        Crowd->RegisterUnit(this);
     }
 }
 
-void AUnit::Tick(float DeltaTime)
+void AUnit::DeactivateUnit()
 {
-    Super::Tick(DeltaTime);
+    // Back to how the class spawns, while the renderer still knows the unit
+    SetSelected(false);
+    SetTeamColor(GetClass()->GetDefaultObject<AUnit>()->TeamColor);
 
-    if (bIsMoving)
+    if (UCrowdSubsystem* Crowd = GetCrowd())
+    {
+        Crowd->UnregisterUnit(this);
+    }
+    if (UUnitRenderSubsystem* Renderer = GetRenderer())
     {
-        UE_LOG(LogTemp, Warning, TEXT("%s is moving towards %s"), *GetName(), *TargetDestination.ToString());
-        UpdateMovement(DeltaTime);
+        Renderer->RemoveUnit(this);
     }
+
+    bInPool = true;
+    SetActorHiddenInGame(true);
+    SetActorEnableCollision(false);
+    SetActorTickEnabled(false);
 }
 
-void AUnit::SetDestination(const FVector& NewDestination)
+UCrowdSubsystem* AUnit::GetCrowd() const
 {
-    TargetDestination = NewDestination;
-    bIsMoving = true;
-    StuckTime = 0.0f;
-
-    MovementComponent->Activate(true);  // ✅ Ensure movement is active
+    return GetWorld() ? GetWorld()->GetSubsystem<UCrowdSubsystem>() : nullptr;
+}
 
-    UE_LOG(LogTemp, Warning, TEXT("%s received move command to %s"), *GetName(), *TargetDestination.ToString());
+UUnitRenderSubsystem* AUnit::GetRenderer() const
+{
+    return GetWorld() ? GetWorld()->GetSubsystem<UUnitRenderSubsystem>() : nullptr;
 }
 
-void AUnit::UpdateMovement(float DeltaTime)
+void AUnit::SetSelected(bool bSelected)
 {
-    if (HasReachedDestination())
+    // Instanced units show selection through custom data, which keeps them in their batch
+    if (RenderBatch != INDEX_NONE)
     {
-        bIsMoving = false;
-        MovementComponent->StopMovementImmediately();
+        GetRenderer()->SetUnitSelected(this, bSelected);
         return;
     }
 
-    FVector CurrentLocation = GetActorLocation();
-    FVector DirectionToTarget = (TargetDestination - CurrentLocation).GetSafeNormal();
-    
-    // Check if unit is stuck
-    float MovedDistance = FVector::Distance(CurrentLocation, LastLocation);
-    if (MovedDistance < 1.0f && bIsMoving)
+    if (!UnitMesh) return;
+
+    if (bSelected)
     {
-        StuckTime += DeltaTime;
-        if (StuckTime > 1.0f)  // If stuck for more than 1 second
+        if (SelectedMaterial)
         {
-            // Add a small random offset to help unstuck
-            DirectionToTarget += FVector(FMath::RandRange(-0.3f, 0.3f), FMath::RandRange(-0.3f, 0.3f), 0);
-            DirectionToTarget.Normalize();
-            StuckTime = 0.0f;  // Reset stuck time
+            UnitMesh->SetMaterial(0, SelectedMaterial);
         }
     }
     else
     {
-        StuckTime = 0.0f;
-    }
-    LastLocation = CurrentLocation;
-
-    // Get nearby units for avoidance
-    TArray<AActor*> NearbyUnits;
-    UGameplayStatics::GetAllActorsOfClass(GetWorld(), AUnit::StaticClass(), NearbyUnits);
-
-    FVector AvoidanceVector = FVector::ZeroVector;
-    int32 AvoidCount = 0;
-
-    for (AActor* OtherActor : NearbyUnits)
-    {
-        if (OtherActor != this)
+        if (DefaultMaterial)
         {
-            FVector OtherLocation = OtherActor->GetActorLocation();
-            float Distance = FVector::Distance(CurrentLocation, OtherLocation);
-
-            if (Distance < AvoidanceRadius)
-            {
-                FVector AwayFromOther = (CurrentLocation - OtherLocation).GetSafeNormal();
-                float AvoidanceStrength = FMath::Square(1.0f - (Distance / AvoidanceRadius));  // Square for more natural avoidance
-
-                AvoidanceVector += AwayFromOther * AvoidanceStrength;
-                AvoidCount++;
-            }
+            UnitMesh->SetMaterial(0, DefaultMaterial);
         }
     }
+}
 
-    // Blend avoidance with movement direction
-    FVector FinalDirection = DirectionToTarget;
-    if (AvoidCount > 0)
+void AUnit::SetTeamColor(const FLinearColor& NewTeamColor)
+{
+    TeamColor = NewTeamColor;
+    if (RenderBatch != INDEX_NONE)
     {
-        AvoidanceVector /= AvoidCount;
-        // Adjust the blend factor based on how close we are to other units
-        float BlendFactor = FMath::Clamp(AvoidanceVector.Size(), 0.0f, 0.7f);  // Max 70% influence from avoidance
-        FinalDirection = FMath::Lerp(DirectionToTarget, AvoidanceVector, BlendFactor).GetSafeNormal();
+        GetRenderer()->SetUnitTeamColor(this, TeamColor);
     }
+}
 
-    // Apply movement
-    MovementComponent->AddInputVector(FinalDirection * MovementSpeed * DeltaTime);
-
-    // Smooth rotation
-    FRotator TargetRotation = FinalDirection.Rotation();
-    FRotator NewRotation = FMath::RInterpTo(GetActorRotation(), TargetRotation, DeltaTime, RotationSpeed);
-    SetActorRotation(NewRotation);
+void AUnit::SetDestination(const FVector& NewDestination)
+{
+    if (UCrowdSubsystem* Crowd = GetCrowd())
+    {
+        Crowd->MoveUnitTo(this, NewDestination);
+    }
 }
 
 bool AUnit::HasReachedDestination() const
 {
-    return FVector::Distance(GetActorLocation(), TargetDestination) <= AcceptanceRadius;
+    // The crowd stops a unit once it is within AcceptanceRadius of its destination
+    const UCrowdSubsystem* Crowd = GetCrowd();
+    return !Crowd || !Crowd->IsUnitMoving(this);
 }
\ No newline at end of file
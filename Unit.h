@@ -2,35 +2,67 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Pawn.h"
-#include "GameFramework/FloatingPawnMovement.h"
 #include "Unit.generated.h"
 
+UENUM(BlueprintType)
+enum class EUnitAvoidanceMode : uint8
+{
+    // Blend a push away from nearby units into the direction of travel
+    Steering,
+
+    // Choose velocities that stay clear of nearby units with optimal reciprocal collision avoidance.
+    // Units in this mode don't need pawn overlaps, so those are switched off.
+    Orca
+};
+
+UENUM(BlueprintType)
+enum class EUnitMovementMode : uint8
+{
+    // Sweep against the world when moving, stopping at anything that blocks the unit
+    Swept,
+
+    // Integrate positions directly and slide along impassable cells of the flow field cost grid. No sweeps,
+    // physics or overlap events; other units are kept apart by avoidance alone.
+    Kinematic
+};
+
+// Visual proxy for a unit simulated by UCrowdSubsystem. The unit doesn't tick; the crowd moves every unit
+// in one batched pass and writes the transform back here. The movement properties are read when the unit registers.
+// Classes with bRenderInstanced are drawn by UUnitRenderSubsystem, and their own mesh is only used for collision.
+// Units spawned through UUnitPoolSubsystem are hidden and switched off rather than destroyed when released.
 UCLASS()
 class PROTOTYPE1_API AUnit : public APawn
 {
     GENERATED_BODY()
 
+    friend class UCrowdSubsystem;
+    friend class UUnitRenderSubsystem;
+    friend class UUnitPoolSubsystem;
+
 public:
     AUnit();
-    virtual void Tick(float DeltaTime) override;
     virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
     // Movement functions
     void SetDestination(const FVector& NewDestination);
     bool HasReachedDestination() const;
 
+    // Released to the pool and waiting to be reused; not in play meanwhile
+    bool IsInPool() const { return bInPool; }
+
     // Selection functions
     UFUNCTION(BlueprintCallable, Category = "Selection")
     void SetSelected(bool bSelected);
 
+    UFUNCTION(BlueprintCallable, Category = "Rendering")
+    void SetTeamColor(const FLinearColor& NewTeamColor);
+
 protected:
     // Components
     UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
     UStaticMeshComponent* UnitMesh;
 
-    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
-    UFloatingPawnMovement* MovementComponent;
-
     // Selection properties
     UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Selection")
     UMaterialInterface* DefaultMaterial;
@@ -51,16 +83,35 @@ protected:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Movement", Meta = (ToolTip = "Radius at which units start avoiding each other"))
     float AvoidanceRadius;
 
-    // Movement state
-    bool bIsMoving;
-    FVector TargetDestination;
-    
-    // Stuck detection
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Movement", Meta = (ToolTip = "Time in seconds that a unit is considered stuck"))
-    float StuckTime;
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Movement", Meta = (ToolTip = "Last location of the unit"))
-    FVector LastLocation;
-
-    // Movement update function
-    void UpdateMovement(float DeltaTime);
+    UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Movement")
+    EUnitAvoidanceMode AvoidanceMode;
+
+    UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Movement")
+    EUnitMovementMode MovementMode;
+
+    // Rendering properties
+    UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Rendering", Meta = (ToolTip = "Draw through one shared instanced mesh; the material shows selection and team colour from per-instance custom data"))
+    bool bRenderInstanced;
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Rendering")
+    FLinearColor TeamColor;
+
+private:
+    // Slot in the crowd's unit arrays, INDEX_NONE while not registered
+    int32 CrowdIndex;
+
+    // Batch and instance in UUnitRenderSubsystem, INDEX_NONE while drawn by UnitMesh
+    int32 RenderBatch;
+    int32 RenderInstance;
+
+    bool bInPool;
+
+    // Join the crowd and show the unit; on BeginPlay, and when the pool hands it out again
+    void ActivateUnit();
+
+    // Leave the crowd, hide and switch off collision, and reset per-use state for the next time
+    void DeactivateUnit();
+
+    class UCrowdSubsystem* GetCrowd() const;
+    class UUnitRenderSubsystem* GetRenderer() const;
 };
\ No newline at end of file
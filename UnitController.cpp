@@ -2,6 +2,8 @@
 #include "Kismet/GameplayStatics.h"
 #include "Engine/World.h"
 #include "DrawDebugHelpers.h"
+#include "CrowdSubsystem.h"
+#include "UnitPoolSubsystem.h"
 
 AUnitController::AUnitController()
 {
@@ -9,10 +11,26 @@ AUnitController::AUnitController()
     bIsSelecting = false;
 }
 
+void AUnitController::BeginPlay()
+{
+    Super::BeginPlay();
+
+    UUnitPoolSubsystem* Pool = GetWorld()->GetSubsystem<UUnitPoolSubsystem>();
+    if (Pool && UnitClass && PoolPrewarmCount > 0)
+    {
+        Pool->Prewarm(UnitClass, PoolPrewarmCount);
+    }
+}
+
 void AUnitController::Tick(float DeltaTime)
 {
     Super::Tick(DeltaTime);
 
+    if (PendingSpawns.Num() > 0)
+    {
+        SpawnPendingUnits();
+    }
+
     if (bIsSelecting)
     {
         DrawSelectionBox();
@@ -27,12 +45,34 @@ AUnit* AUnitController::SpawnUnit(const FVector& SpawnLocation)
         return nullptr;
     }
 
+    if (UUnitPoolSubsystem* Pool = GetWorld()->GetSubsystem<UUnitPoolSubsystem>())
+    {
+        return Pool->AcquireUnit(UnitClass, FTransform(SpawnLocation));
+    }
+
     FActorSpawnParameters SpawnParams;
     SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
     
     return GetWorld()->SpawnActor<AUnit>(UnitClass, SpawnLocation, FRotator::ZeroRotator, SpawnParams);
 }
 
+void AUnitController::DespawnUnit(AUnit* Unit)
+{
+    if (!Unit)
+        return;
+
+    SelectedUnits.Remove(Unit);
+
+    if (UUnitPoolSubsystem* Pool = GetWorld()->GetSubsystem<UUnitPoolSubsystem>())
+    {
+        Pool->ReleaseUnit(Unit);
+    }
+    else
+    {
+        Unit->Destroy();
+    }
+}
+
 void AUnitController::MoveUnitTo(AUnit* Unit, const FVector& TargetLocation)
 {
     if (Unit)
@@ -43,12 +83,10 @@ void AUnitController::MoveUnitTo(AUnit* Unit, const FVector& TargetLocation)
 
 TArray<AUnit*> AUnitController::SpawnUnitsInGrid(const FVector& CenterLocation, int32 Rows, int32 Columns, float Spacing)
 {
-    TArray<AUnit*> SpawnedUnits;
-    
     if (!UnitClass)
     {
         UE_LOG(LogTemp, Warning, TEXT("UnitController: UnitClass is not set! Please set it in Blueprint."));
-        return SpawnedUnits;
+        return TArray<AUnit*>();
     }
 
     // Calculate start position for grid (top-left corner)
@@ -56,7 +94,9 @@ TArray<AUnit*> AUnitController::SpawnUnitsInGrid(const FVector& CenterLocation,
     StartPos.X -= (Columns - 1) * Spacing * 0.5f;
     StartPos.Y -= (Rows - 1) * Spacing * 0.5f;
 
-    // Spawn units in grid pattern
+    // Spawning the grid all at once would hitch on large waves, so it goes out in batches
+    FPendingSpawnRequest Request;
+    Request.Locations.Reserve(FMath::Max(Rows * Columns, 0));
     for (int32 Row = 0; Row < Rows; Row++)
     {
         for (int32 Column = 0; Column < Columns; Column++)
@@ -65,17 +105,61 @@ TArray<AUnit*> AUnitController::SpawnUnitsInGrid(const FVector& CenterLocation,
             SpawnPos.X += Column * Spacing;
             SpawnPos.Y += Row * Spacing;
 
-            AUnit* NewUnit = SpawnUnit(SpawnPos);
-            if (NewUnit)
-            {
-                SpawnedUnits.Add(NewUnit);
-            }
+            Request.Locations.Add(SpawnPos);
         }
     }
 
+    // The first batch comes from this grid even while earlier ones are still queued, so the caller gets its own units
+    TArray<AUnit*> SpawnedUnits = SpawnPendingBatch(Request, FPlatformTime::Seconds() + SpawnBudgetMs / 1000.0);
+    if (!Request.IsDone())
+    {
+        PendingSpawns.Add(MoveTemp(Request));
+    }
+    return SpawnedUnits;
+}
+
+TArray<AUnit*> AUnitController::SpawnPendingBatch(FPendingSpawnRequest& Request, double EndTime)
+{
+    TArray<AUnit*> SpawnedUnits;
+    if (Request.IsDone())
+        return SpawnedUnits;
+
+    do
+    {
+        AUnit* NewUnit = SpawnUnit(Request.Locations[Request.Head++]);
+        if (NewUnit)
+        {
+            SpawnedUnits.Add(NewUnit);
+        }
+    }
+    while (!Request.IsDone() && FPlatformTime::Seconds() < EndTime);
+
+    if (SpawnedUnits.Num() > 0)
+    {
+        OnUnitsSpawned.Broadcast(SpawnedUnits);
+    }
     return SpawnedUnits;
 }
 
+void AUnitController::SpawnPendingUnits()
+{
+    const double EndTime = FPlatformTime::Seconds() + SpawnBudgetMs / 1000.0;
+
+    // Finished grids are dropped whole, so the queue never holds more than the grids still spawning
+    int32 NumDone = 0;
+    while (NumDone < PendingSpawns.Num())
+    {
+        SpawnPendingBatch(PendingSpawns[NumDone], EndTime);
+        if (!PendingSpawns[NumDone].IsDone())
+            break;
+
+        ++NumDone;
+        if (FPlatformTime::Seconds() >= EndTime)
+            break;
+    }
+    PendingSpawns.RemoveAt(0, NumDone);
+}
+
 void AUnitController::StartSelection(const FVector2D& ScreenPosition)
 {
     bIsSelecting = true;
@@ -118,7 +202,7 @@ void AUnitController::UpdateSelectedUnits()
     for (AActor* Actor : FoundUnits)
     {
         AUnit* Unit = Cast<AUnit>(Actor);
-        if (Unit && IsUnitInSelectionBox(Unit))
+        if (Unit && !Unit->IsInPool() && IsUnitInSelectionBox(Unit))
         {
             SelectedUnits.Add(Unit);
             Unit->SetSelected(true);
@@ -198,6 +282,13 @@ void AUnitController::DrawSelectionBox()
 
 void AUnitController::MoveSelectedUnitsTo(const FVector& TargetLocation)
 {
+    // One flow field for the whole selection rather than a path per unit
+    if (UCrowdSubsystem* Crowd = GetWorld()->GetSubsystem<UCrowdSubsystem>())
+    {
+        Crowd->MoveGroupTo(SelectedUnits, TargetLocation);
+        return;
+    }
+
     for (AUnit* Unit : SelectedUnits)
     {
         if (Unit)
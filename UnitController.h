@@ -5,6 +5,8 @@
 #include "Unit.h"
 #include "UnitController.generated.h"
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnUnitsSpawned, const TArray<AUnit*>&, Units);
+
 UCLASS()
 class PROTOTYPE1_API AUnitController : public AActor
 {
@@ -12,15 +14,25 @@ class PROTOTYPE1_API AUnitController : public AActor
 
 public:
     AUnitController();
+    virtual void BeginPlay() override;
     virtual void Tick(float DeltaTime) override;
 
     // Spawn functions
     UFUNCTION(BlueprintCallable, Category = "Unit Control")
     AUnit* SpawnUnit(const FVector& SpawnLocation);
 
+    // Spawns as many units of this grid as fit in SpawnBudgetMs now and returns them; the rest follow over the next
+    // frames, after any grids queued earlier. OnUnitsSpawned fires for every batch, each holding units of one grid only.
     UFUNCTION(BlueprintCallable, Category = "Unit Control")
     TArray<AUnit*> SpawnUnitsInGrid(const FVector& CenterLocation, int32 Rows, int32 Columns, float Spacing);
 
+    // Return a unit to the pool
+    UFUNCTION(BlueprintCallable, Category = "Unit Control")
+    void DespawnUnit(AUnit* Unit);
+
+    UPROPERTY(BlueprintAssignable, Category = "Unit Control")
+    FOnUnitsSpawned OnUnitsSpawned;
+
     // Selection functions
     UFUNCTION(BlueprintCallable, Category = "Unit Selection")
     void StartSelection(const FVector2D& ScreenPosition);
@@ -50,6 +62,14 @@ protected:
     UPROPERTY(EditDefaultsOnly, Category = "Unit Control")
     float DefaultSpacing = 200.0f;
 
+    // Units of UnitClass spawned into the pool at level load, so early waves don't spawn actors
+    UPROPERTY(EditDefaultsOnly, Category = "Unit Control")
+    int32 PoolPrewarmCount = 0;
+
+    // Time per frame spent spawning queued grid units
+    UPROPERTY(EditDefaultsOnly, Category = "Unit Control", Meta = (ClampMin = "0.1"))
+    float SpawnBudgetMs = 2.0f;
+
     // Selection properties
     UPROPERTY(VisibleAnywhere, Category = "Unit Selection")
     TArray<AUnit*> SelectedUnits;
@@ -62,6 +82,24 @@ private:
     FVector2D SelectionStart;
     FVector2D SelectionEnd;
 
+    // A grid still being spawned, its next position at Head
+    struct FPendingSpawnRequest
+    {
+        TArray<FVector> Locations;
+        int32 Head = 0;
+
+        bool IsDone() const { return Head >= Locations.Num(); }
+    };
+
+    // Grids waiting to finish spawning, oldest first
+    TArray<FPendingSpawnRequest> PendingSpawns;
+
+    // Spawn from one grid until EndTime, at least one unit so it always progresses, and broadcast the batch
+    TArray<AUnit*> SpawnPendingBatch(FPendingSpawnRequest& Request, double EndTime);
+
+    // Spend this frame's budget on the queued grids, oldest first
+    void SpawnPendingUnits();
+
     // Helper functions
     void UpdateSelectedUnits();
     bool IsUnitInSelectionBox(const AUnit* Unit) const;
@@ -0,0 +1,136 @@
+#include "UnitEventLog.h"
+
+#if UNIT_EVENT_LOG
+
+#include "HAL/IConsoleManager.h"
+#include "UObject/UObjectArray.h"
+#include <atomic>
+
+namespace UnitEventLog
+{
+    // About 3.5 MB; several seconds of a few hundred busy units
+    constexpr uint64 Capacity = 1 << 16;
+    constexpr uint64 Mask = Capacity - 1;
+
+    struct FRecord
+    {
+        // Ticket + 1 once the record is written, 0 while it is being written
+        std::atomic<uint64> Sequence{ 0 };
+        double Time;
+        FVector3f Location;
+        FVector3f Target;
+        int32 UnitIndex;
+        int32 UnitSerial;
+        EUnitEvent Event;
+    };
+
+    static FRecord Records[Capacity];
+    static std::atomic<uint64> NextTicket{ 0 };
+
+    static const TCHAR* GetEventName(EUnitEvent Event)
+    {
+        switch (Event)
+        {
+        case EUnitEvent::MoveOrder: return TEXT("MoveOrder");
+        case EUnitEvent::Steer: return TEXT("Steer");
+        case EUnitEvent::Arrive: return TEXT("Arrive");
+        }
+        return TEXT("Unknown");
+    }
+}
+
+void FUnitEventLog::Record(EUnitEvent Event, const UObject* Unit, const FVector& Location, const FVector& Target)
+{
+    using namespace UnitEventLog;
+
+    // The index alone would name whatever reuses the slot once the unit is collected; the serial number tells them apart.
+    // Allocating it is thread safe and only happens once per object.
+    const int32 UnitIndex = GUObjectArray.ObjectToIndex(Unit);
+    const int32 UnitSerial = GUObjectArray.AllocateSerialNumber(UnitIndex);
+
+    // Each writer claims its own slot, so the only contention is the one increment
+    const uint64 Ticket = NextTicket.fetch_add(1, std::memory_order_relaxed);
+    FRecord& Record = Records[Ticket & Mask];
+
+    Record.Sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Record.Time = FPlatformTime::Seconds();
+    Record.Location = FVector3f(Location);
+    Record.Target = FVector3f(Target);
+    Record.UnitIndex = UnitIndex;
+    Record.UnitSerial = UnitSerial;
+    Record.Event = Event;
+
+    Record.Sequence.store(Ticket + 1, std::memory_order_release);
+}
+
+void FUnitEventLog::Dump(float Seconds)
+{
+    using namespace UnitEventLog;
+
+    struct FEntry
+    {
+        double Time;
+        FVector3f Location;
+        FVector3f Target;
+        int32 UnitIndex;
+        int32 UnitSerial;
+        EUnitEvent Event;
+    };
+
+    const double Now = FPlatformTime::Seconds();
+    const uint64 End = NextTicket.load(std::memory_order_acquire);
+    const uint64 Begin = End > Capacity ? End - Capacity : 0;
+
+    // Newest first until the events get too old. A record whose sequence changed while it was copied was
+    // overwritten or is still being written, and is skipped.
+    TArray<FEntry> Entries;
+    for (uint64 Ticket = End; Ticket > Begin; --Ticket)
+    {
+        const FRecord& Record = Records[(Ticket - 1) & Mask];
+        const uint64 Sequence = Record.Sequence.load(std::memory_order_acquire);
+        if (Sequence != Ticket)
+            continue;
+
+        const FEntry Entry = { Record.Time, Record.Location, Record.Target, Record.UnitIndex, Record.UnitSerial, Record.Event };
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (Record.Sequence.load(std::memory_order_relaxed) != Sequence)
+            continue;
+
+        if (Now - Entry.Time > Seconds)
+            break;
+
+        Entries.Add(Entry);
+    }
+
+    UE_LOG(LogTemp, Display, TEXT("Unit events in the last %.1f s: %d"), Seconds, Entries.Num());
+    for (int32 Index = Entries.Num() - 1; Index >= 0; --Index)
+    {
+        const FEntry& Entry = Entries[Index];
+
+        // The unit may be gone by now, its slot even reused, in which case only its id is left
+        FString UnitName = FString::Printf(TEXT("#%d"), Entry.UnitIndex);
+        const FUObjectItem* Item = GUObjectArray.IndexToObject(Entry.UnitIndex);
+        if (Item && Item->Object && Item->GetSerialNumber() == Entry.UnitSerial)
+        {
+            UnitName = static_cast<const UObject*>(Item->Object)->GetName();
+        }
+
+        UE_LOG(LogTemp, Display, TEXT("%8.3f %-9s %s at %s towards %s"), Entry.Time - Now, GetEventName(Entry.Event), *UnitName,
+            *FVector(Entry.Location).ToString(), *FVector(Entry.Target).ToString());
+    }
+}
+
+static void DumpUnitEvents(const TArray<FString>& Args)
+{
+    const float Seconds = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 5.0f;
+    FUnitEventLog::Dump(Seconds);
+}
+
+static FAutoConsoleCommand DumpUnitEventsCommand(
+    TEXT("Crowd.DumpEvents"),
+    TEXT("Log the unit movement events recorded in the last few seconds. Args: [Seconds=5]"),
+    FConsoleCommandWithArgsDelegate::CreateStatic(&DumpUnitEvents));
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Movement event log, compiled out unless UNIT_EVENT_LOG is set to 1 (e.g. PublicDefinitions in the Build.cs).
+// Events are fixed-size binary records written into a lock-free ring buffer, safe from the steering threads, and
+// nothing is formatted until Crowd.DumpEvents prints the last few seconds of them.
+#ifndef UNIT_EVENT_LOG
+#define UNIT_EVENT_LOG 0
+#endif
+
+enum class EUnitEvent : uint8
+{
+    // A unit was given a destination
+    MoveOrder,
+
+    // A unit was steered towards its destination this step
+    Steer,
+
+    // A unit came within its acceptance radius and stopped
+    Arrive,
+};
+
+#if UNIT_EVENT_LOG
+
+class UObject;
+
+class PROTOTYPE1_API FUnitEventLog
+{
+public:
+    // Append an event, overwriting the oldest once the buffer is full. Only the unit's object index and serial number are kept.
+    static void Record(EUnitEvent Event, const UObject* Unit, const FVector& Location, const FVector& Target);
+
+    // Log the events recorded in the last Seconds, oldest first
+    static void Dump(float Seconds);
+};
+
+#define UNIT_EVENT(Event, Unit, Location, Target) FUnitEventLog::Record(EUnitEvent::Event, Unit, Location, Target)
+
+#else
+
+#define UNIT_EVENT(Event, Unit, Location, Target)
+
+#endif
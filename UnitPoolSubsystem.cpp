@@ -0,0 +1,84 @@
+#include "UnitPoolSubsystem.h"
+#include "Unit.h"
+#include "Engine/World.h"
+
+void UUnitPoolSubsystem::Deinitialize()
+{
+    Pools.Reset();
+    Super::Deinitialize();
+}
+
+void UUnitPoolSubsystem::Prewarm(TSubclassOf<AUnit> UnitClass, int32 Count)
+{
+    if (!UnitClass)
+        return;
+
+    FUnitPoolBucket& Pool = Pools.FindOrAdd(UnitClass);
+    Pool.Units.Reserve(Pool.Units.Num() + Count);
+
+    for (int32 Spawned = 0; Spawned < Count; ++Spawned)
+    {
+        if (AUnit* Unit = SpawnPooledUnit(UnitClass))
+        {
+            Pool.Units.Add(Unit);
+        }
+    }
+}
+
+AUnit* UUnitPoolSubsystem::AcquireUnit(TSubclassOf<AUnit> UnitClass, const FTransform& Transform)
+{
+    if (!UnitClass)
+        return nullptr;
+
+    AUnit* Unit = nullptr;
+    if (FUnitPoolBucket* Pool = Pools.Find(UnitClass))
+    {
+        // Pooled units can still be destroyed from outside, e.g. by a level unloading
+        while (!Unit && Pool->Units.Num() > 0)
+        {
+            AUnit* Candidate = Pool->Units.Pop(false);
+            if (IsValid(Candidate))
+            {
+                Unit = Candidate;
+            }
+        }
+    }
+
+    if (!Unit)
+    {
+        Unit = SpawnPooledUnit(UnitClass);
+        if (!Unit)
+            return nullptr;
+    }
+
+    Unit->SetActorTransform(Transform, false, nullptr, ETeleportType::ResetPhysics);
+    Unit->ActivateUnit();
+    return Unit;
+}
+
+void UUnitPoolSubsystem::ReleaseUnit(AUnit* Unit)
+{
+    if (!IsValid(Unit) || Unit->bInPool)
+        return;
+
+    Unit->DeactivateUnit();
+    Pools.FindOrAdd(Unit->GetClass()).Units.Add(Unit);
+}
+
+int32 UUnitPoolSubsystem::GetNumPooled(TSubclassOf<AUnit> UnitClass) const
+{
+    const FUnitPoolBucket* Pool = Pools.Find(UnitClass);
+    return Pool ? Pool->Units.Num() : 0;
+}
+
+AUnit* UUnitPoolSubsystem::SpawnPooledUnit(TSubclassOf<AUnit> UnitClass)
+{
+    AUnit* Unit = GetWorld()->SpawnActorDeferred<AUnit>(UnitClass, FTransform::Identity, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+    if (!Unit)
+        return nullptr;
+
+    Unit->bInPool = true;
+    Unit->FinishSpawning(FTransform::Identity);
+    Unit->DeactivateUnit();
+    return Unit;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UnitPoolSubsystem.generated.h"
+
+class AUnit;
+
+USTRUCT()
+struct FUnitPoolBucket
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+    TArray<AUnit*> Units;
+};
+
+// Recycles units so waves can be spawned and killed without a SpawnActor per unit or a pile of actors for GC.
+// Released units stay in the level hidden, without collision and out of the crowd, and are reset when acquired again.
+UCLASS()
+class PROTOTYPE1_API UUnitPoolSubsystem : public UWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    virtual void Deinitialize() override;
+
+    // Spawn units up front so the first waves come out of the pool; meant for level load
+    void Prewarm(TSubclassOf<AUnit> UnitClass, int32 Count);
+
+    // Place a unit of UnitClass at Transform, taking it from the pool when there is one
+    AUnit* AcquireUnit(TSubclassOf<AUnit> UnitClass, const FTransform& Transform);
+
+    // Return a unit to the pool instead of destroying it
+    void ReleaseUnit(AUnit* Unit);
+
+    int32 GetNumPooled(TSubclassOf<AUnit> UnitClass) const;
+
+private:
+    // Spawn a unit straight into the pool, so it never joins the crowd on BeginPlay
+    AUnit* SpawnPooledUnit(TSubclassOf<AUnit> UnitClass);
+
+    UPROPERTY()
+    TMap<UClass*, FUnitPoolBucket> Pools;
+};
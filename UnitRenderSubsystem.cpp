@@ -0,0 +1,189 @@
+#include "UnitRenderSubsystem.h"
+#include "Unit.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/World.h"
+
+void UUnitRenderSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+    Super::Initialize(Collection);
+
+    InstanceOwner = nullptr;
+    PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &UUnitRenderSubsystem::FlushTransforms);
+}
+
+void UUnitRenderSubsystem::Deinitialize()
+{
+    FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+
+    for (FUnitBatch& Batch : Batches)
+    {
+        for (AUnit* Unit : Batch.Units)
+        {
+            Unit->RenderBatch = INDEX_NONE;
+            Unit->RenderInstance = INDEX_NONE;
+            Unit->UnitMesh->TransformUpdated.RemoveAll(this);
+        }
+    }
+
+    Batches.Reset();
+    BatchIndices.Reset();
+    InstanceOwner = nullptr;
+    Super::Deinitialize();
+}
+
+void UUnitRenderSubsystem::AddUnit(AUnit* Unit)
+{
+    if (!Unit || !Unit->UnitMesh || !Unit->UnitMesh->GetStaticMesh() || Unit->RenderBatch != INDEX_NONE)
+        return;
+
+    const int32 BatchIndex = FindOrAddBatch(Unit->UnitMesh->GetStaticMesh(), Unit->UnitMesh->GetMaterial(0));
+    if (BatchIndex == INDEX_NONE)
+        return;
+
+    FUnitBatch& Batch = Batches[BatchIndex];
+    const FTransform& Transform = Unit->UnitMesh->GetComponentTransform();
+
+    Unit->RenderBatch = BatchIndex;
+    Unit->RenderInstance = Batch.Component->AddInstance(Transform, true);
+    check(Unit->RenderInstance == Batch.Units.Num());
+
+    Batch.Units.Add(Unit);
+    Batch.Transforms.Add(Transform);
+    Batch.CustomData.AddZeroed(NumCustomData);
+
+    const FLinearColor& TeamColor = Unit->TeamColor;
+    SetCustomData(Unit, CustomData_TeamColor, { TeamColor.R, TeamColor.G, TeamColor.B });
+
+    Unit->UnitMesh->TransformUpdated.AddUObject(this, &UUnitRenderSubsystem::OnUnitMoved);
+}
+
+void UUnitRenderSubsystem::RemoveUnit(AUnit* Unit)
+{
+    if (!IsValidInstance(Unit))
+        return;
+
+    FUnitBatch& Batch = Batches[Unit->RenderBatch];
+    const int32 Index = Unit->RenderInstance;
+    const int32 LastIndex = Batch.Units.Num() - 1;
+
+    // Move the last instance into the hole so only that one unit's index changes. Removing the last
+    // instance doesn't shift any others.
+    if (Index != LastIndex)
+    {
+        AUnit* MovedUnit = Batch.Units[LastIndex];
+        Batch.Units[Index] = MovedUnit;
+        Batch.Transforms[Index] = Batch.Transforms[LastIndex];
+        FMemory::Memcpy(&Batch.CustomData[Index * NumCustomData], &Batch.CustomData[LastIndex * NumCustomData], NumCustomData * sizeof(float));
+        MovedUnit->RenderInstance = Index;
+
+        Batch.Component->UpdateInstanceTransform(Index, Batch.Transforms[Index], true);
+        Batch.Component->SetCustomData(Index, MakeArrayView(&Batch.CustomData[Index * NumCustomData], NumCustomData));
+    }
+
+    Batch.Component->RemoveInstance(LastIndex);
+    Batch.Units.Pop(false);
+    Batch.Transforms.Pop(false);
+    Batch.CustomData.SetNum(LastIndex * NumCustomData, false);
+    Batch.Component->MarkRenderStateDirty();
+
+    Unit->UnitMesh->TransformUpdated.RemoveAll(this);
+    Unit->RenderBatch = INDEX_NONE;
+    Unit->RenderInstance = INDEX_NONE;
+}
+
+void UUnitRenderSubsystem::SetUnitSelected(const AUnit* Unit, bool bSelected)
+{
+    SetCustomData(Unit, CustomData_Selected, { bSelected ? 1.0f : 0.0f });
+}
+
+void UUnitRenderSubsystem::SetUnitTeamColor(const AUnit* Unit, const FLinearColor& TeamColor)
+{
+    SetCustomData(Unit, CustomData_TeamColor, { TeamColor.R, TeamColor.G, TeamColor.B });
+}
+
+int32 UUnitRenderSubsystem::FindOrAddBatch(UStaticMesh* Mesh, UMaterialInterface* Material)
+{
+    const TPair<UStaticMesh*, UMaterialInterface*> Key(Mesh, Material);
+    if (const int32* Existing = BatchIndices.Find(Key))
+        return *Existing;
+
+    if (!InstanceOwner)
+    {
+        FActorSpawnParameters SpawnParams;
+        SpawnParams.Name = TEXT("UnitInstances");
+        SpawnParams.NameMode = FActorSpawnParameters::ESpawnActorNameMode::Requested;
+        SpawnParams.ObjectFlags |= RF_Transient;
+
+        InstanceOwner = GetWorld()->SpawnActor<AActor>(SpawnParams);
+        if (!InstanceOwner)
+            return INDEX_NONE;
+
+        USceneComponent* Root = NewObject<USceneComponent>(InstanceOwner, TEXT("Root"));
+        InstanceOwner->SetRootComponent(Root);
+        Root->RegisterComponent();
+    }
+
+    UInstancedStaticMeshComponent* Component = NewObject<UInstancedStaticMeshComponent>(InstanceOwner);
+    Component->SetMobility(EComponentMobility::Movable);
+    Component->SetStaticMesh(Mesh);
+    Component->SetMaterial(0, Material);
+    Component->NumCustomDataFloats = NumCustomData;
+
+    // Each unit keeps its own hidden mesh for collision and traces
+    Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+    Component->SetGenerateOverlapEvents(false);
+    Component->SetupAttachment(InstanceOwner->GetRootComponent());
+    Component->RegisterComponent();
+
+    FUnitBatch& Batch = Batches.AddDefaulted_GetRef();
+    Batch.Component = Component;
+    return BatchIndices.Add(Key, Batches.Num() - 1);
+}
+
+bool UUnitRenderSubsystem::IsValidInstance(const AUnit* Unit) const
+{
+    return Unit && Batches.IsValidIndex(Unit->RenderBatch) && Batches[Unit->RenderBatch].Units.IsValidIndex(Unit->RenderInstance)
+        && Batches[Unit->RenderBatch].Units[Unit->RenderInstance] == Unit;
+}
+
+void UUnitRenderSubsystem::SetCustomData(const AUnit* Unit, int32 First, TArrayView<const float> Values)
+{
+    if (!IsValidInstance(Unit))
+        return;
+
+    FUnitBatch& Batch = Batches[Unit->RenderBatch];
+    const int32 Offset = Unit->RenderInstance * NumCustomData;
+    for (int32 Value = 0; Value < Values.Num(); ++Value)
+    {
+        Batch.CustomData[Offset + First + Value] = Values[Value];
+    }
+
+    Batch.Component->SetCustomData(Unit->RenderInstance, MakeArrayView(&Batch.CustomData[Offset], NumCustomData), true);
+}
+
+void UUnitRenderSubsystem::OnUnitMoved(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+    const AUnit* Unit = Cast<AUnit>(UpdatedComponent->GetOwner());
+    if (!IsValidInstance(Unit))
+        return;
+
+    // Only recorded here; the component is updated once for the whole batch at the end of the frame
+    FUnitBatch& Batch = Batches[Unit->RenderBatch];
+    Batch.Transforms[Unit->RenderInstance] = UpdatedComponent->GetComponentTransform();
+    Batch.bTransformsDirty = true;
+}
+
+void UUnitRenderSubsystem::FlushTransforms(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+    if (World != GetWorld())
+        return;
+
+    for (FUnitBatch& Batch : Batches)
+    {
+        if (!Batch.bTransformsDirty)
+            continue;
+
+        Batch.Component->BatchUpdateInstancesTransforms(0, Batch.Transforms, true, true, true);
+        Batch.bTransformsDirty = false;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UnitRenderSubsystem.generated.h"
+
+class AUnit;
+class UInstancedStaticMeshComponent;
+
+// Draws units that render instanced, through one instanced static mesh component per mesh and material, so draw
+// calls stay flat however many units there are. Each instance follows its unit's actor: moves are recorded as they
+// happen and pushed to each component in one batch at the end of the frame.
+// Instances carry custom data for the unit material to read with PerInstanceCustomData:
+// index 0 is the selection highlight (0 or 1) and 1-3 the team colour.
+// Plain instanced components rather than HISM, since units move every frame and HISM would rebuild its tree each time.
+UCLASS()
+class PROTOTYPE1_API UUnitRenderSubsystem : public UWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+    virtual void Deinitialize() override;
+
+    // Start drawing a unit with its mesh's current mesh and first material. The unit's own mesh is left to the caller.
+    void AddUnit(AUnit* Unit);
+    void RemoveUnit(AUnit* Unit);
+
+    void SetUnitSelected(const AUnit* Unit, bool bSelected);
+    void SetUnitTeamColor(const AUnit* Unit, const FLinearColor& TeamColor);
+
+    // One draw per batch, whatever the number of units in it
+    int32 GetNumBatches() const { return Batches.Num(); }
+
+private:
+    enum ECustomData : int32
+    {
+        CustomData_Selected = 0,
+        CustomData_TeamColor = 1,
+        NumCustomData = 4,
+    };
+
+    // Units sharing a mesh and material, by instance index
+    struct FUnitBatch
+    {
+        // Kept alive by InstanceOwner, which it is attached to
+        UInstancedStaticMeshComponent* Component = nullptr;
+        TArray<AUnit*> Units;
+        TArray<FTransform> Transforms;
+        TArray<float> CustomData;
+        bool bTransformsDirty = false;
+    };
+
+    int32 FindOrAddBatch(UStaticMesh* Mesh, UMaterialInterface* Material);
+    bool IsValidInstance(const AUnit* Unit) const;
+    void SetCustomData(const AUnit* Unit, int32 First, TArrayView<const float> Values);
+
+    void OnUnitMoved(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+
+    // After every actor has ticked, push each batch that moved to its component in one call
+    void FlushTransforms(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+
+    // Holds the instanced components; spawned with the first instanced unit
+    UPROPERTY()
+    AActor* InstanceOwner;
+
+    TArray<FUnitBatch> Batches;
+    TMap<TPair<UStaticMesh*, UMaterialInterface*>, int32> BatchIndices;
+
+    FDelegateHandle PostActorTickHandle;
+};
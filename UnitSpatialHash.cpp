@@ -0,0 +1,116 @@
+#include "UnitSpatialHash.h"
+
+void FUnitSpatialHash::Rebuild(TArrayView<const FVector> Locations, float InCellSize)
+{
+    CellSize = FMath::Max(InCellSize, 1.0f);
+
+    // About two buckets per point keeps collisions between unrelated cells rare
+    const int32 NumBuckets = FMath::RoundUpToPowerOfTwo(FMath::Max(Locations.Num() * 2, 64));
+    BucketStarts.Reset();
+    BucketStarts.SetNumZeroed(NumBuckets + 1);
+
+    TArray<int32> PointBuckets;
+    PointBuckets.SetNumUninitialized(Locations.Num());
+
+    // Count points per bucket, then turn the counts into start offsets
+    for (int32 Index = 0; Index < Locations.Num(); ++Index)
+    {
+        PointBuckets[Index] = CellToBucket(LocationToCell(ToPlane(Locations[Index])));
+        ++BucketStarts[PointBuckets[Index] + 1];
+    }
+    for (int32 Bucket = 0; Bucket < NumBuckets; ++Bucket)
+    {
+        BucketStarts[Bucket + 1] += BucketStarts[Bucket];
+    }
+
+    SortedIndices.SetNumUninitialized(Locations.Num());
+    SortedLocations.SetNumUninitialized(Locations.Num());
+    SortedCells.SetNumUninitialized(Locations.Num());
+
+    TArray<int32> NextSlot(BucketStarts.GetData(), NumBuckets);
+    for (int32 Index = 0; Index < Locations.Num(); ++Index)
+    {
+        const int32 Slot = NextSlot[PointBuckets[Index]]++;
+        SortedIndices[Slot] = Index;
+        SortedLocations[Slot] = ToPlane(Locations[Index]);
+        SortedCells[Slot] = LocationToCell(SortedLocations[Slot]);
+    }
+}
+
+void FUnitSpatialHash::QueryRadius(const FVector& Center, float Radius, TArray<int32>& OutIndices) const
+{
+    ForEachInRadius(Center, Radius, [&OutIndices](int32 Index, float DistSquared) { OutIndices.Add(Index); });
+}
+
+void FUnitSpatialHash::QueryNearest(const FVector& Center, int32 Count, float MaxRadius, TArray<int32>& OutIndices) const
+{
+    if (SortedIndices.Num() == 0 || Count <= 0)
+        return;
+
+    struct FCandidate
+    {
+        int32 Index;
+        float DistSquared;
+    };
+
+    // Max-heap on distance, so the worst of the best Count found so far is on top
+    auto FurtherFirst = [](const FCandidate& A, const FCandidate& B) { return A.DistSquared > B.DistSquared; };
+    TArray<FCandidate, TInlineAllocator<16>> Best;
+
+    const FVector2f Center2D = ToPlane(Center);
+    const float MaxRadiusSquared = FMath::Square(MaxRadius);
+    const FIntPoint CenterCell = LocationToCell(Center2D);
+    const int32 MaxRing = FMath::CeilToInt(MaxRadius / CellSize);
+
+    auto VisitCell = [&](const FIntPoint& Cell)
+    {
+        ForEachInCell(Cell, [&](int32 Slot)
+        {
+            const float DistSquared = FVector2f::DistSquared(SortedLocations[Slot], Center2D);
+            if (DistSquared > MaxRadiusSquared)
+                return;
+
+            if (Best.Num() < Count)
+            {
+                Best.HeapPush({ SortedIndices[Slot], DistSquared }, FurtherFirst);
+            }
+            else if (DistSquared < Best.HeapTop().DistSquared)
+            {
+                Best.HeapPopDiscard(FurtherFirst, false);
+                Best.HeapPush({ SortedIndices[Slot], DistSquared }, FurtherFirst);
+            }
+        });
+    };
+
+    // Walk outward one square ring of cells at a time. Every point beyond ring R is at least R cells away,
+    // so once the heap is full and its worst entry is closer than that, nothing further out can get in.
+    for (int32 Ring = 0; Ring <= MaxRing; ++Ring)
+    {
+        if (Ring == 0)
+        {
+            VisitCell(CenterCell);
+        }
+        else
+        {
+            for (int32 Offset = -Ring; Offset <= Ring; ++Offset)
+            {
+                VisitCell(CenterCell + FIntPoint(Offset, -Ring));
+                VisitCell(CenterCell + FIntPoint(Offset, Ring));
+            }
+            for (int32 Offset = -Ring + 1; Offset <= Ring - 1; ++Offset)
+            {
+                VisitCell(CenterCell + FIntPoint(-Ring, Offset));
+                VisitCell(CenterCell + FIntPoint(Ring, Offset));
+            }
+        }
+
+        if (Best.Num() == Count && Best.HeapTop().DistSquared <= FMath::Square(Ring * CellSize))
+            break;
+    }
+
+    Best.Sort([](const FCandidate& A, const FCandidate& B) { return A.DistSquared < B.DistSquared; });
+    for (const FCandidate& Candidate : Best)
+    {
+        OutIndices.Add(Candidate.Index);
+    }
+}
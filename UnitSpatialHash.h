@@ -0,0 +1,88 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Uniform grid over the XY plane for finding points near a location.
+// Rebuilt from scratch with a counting sort, so the points of each cell sit next to each other in one flat array
+// and a query only reads the cells it overlaps. Cells are hashed into a power-of-two bucket table, so the grid has no bounds.
+class PROTOTYPE1_API FUnitSpatialHash
+{
+public:
+    // Replace the contents with Locations. Queries return indices into this array.
+    void Rebuild(TArrayView<const FVector> Locations, float InCellSize);
+
+    // Indices of the points within Radius of Center, ignoring height, in no particular order
+    void QueryRadius(const FVector& Center, float Radius, TArray<int32>& OutIndices) const;
+
+    // Call Visit(Index, DistSquared) for every point within Radius of Center without collecting them.
+    // Only reads the hash, so any number of threads can query it at once.
+    template <typename VisitorType>
+    void ForEachInRadius(const FVector& Center, float Radius, VisitorType&& Visit) const
+    {
+        if (SortedIndices.Num() == 0)
+            return;
+
+        const FVector2f Center2D = ToPlane(Center);
+        const float RadiusSquared = FMath::Square(Radius);
+        const FIntPoint MinCell = LocationToCell(Center2D - FVector2f(Radius));
+        const FIntPoint MaxCell = LocationToCell(Center2D + FVector2f(Radius));
+
+        for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+        {
+            for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+            {
+                ForEachInCell(FIntPoint(X, Y), [&](int32 Slot)
+                {
+                    const float DistSquared = FVector2f::DistSquared(SortedLocations[Slot], Center2D);
+                    if (DistSquared <= RadiusSquared)
+                    {
+                        Visit(SortedIndices[Slot], DistSquared);
+                    }
+                });
+            }
+        }
+    }
+
+    // Indices of up to Count points nearest Center and no further than MaxRadius, closest first
+    void QueryNearest(const FVector& Center, int32 Count, float MaxRadius, TArray<int32>& OutIndices) const;
+
+    int32 Num() const { return SortedIndices.Num(); }
+    float GetCellSize() const { return CellSize; }
+
+private:
+    static FVector2f ToPlane(const FVector& Location) { return FVector2f(float(Location.X), float(Location.Y)); }
+
+    FIntPoint LocationToCell(const FVector2f& Location) const
+    {
+        return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+    }
+
+    int32 CellToBucket(const FIntPoint& Cell) const
+    {
+        return int32(((uint32(Cell.X) * 73856093u) ^ (uint32(Cell.Y) * 19349663u)) & uint32(BucketStarts.Num() - 2));
+    }
+
+    // Call Visit for every point stored in Cell. Buckets are shared between cells that hash alike, so the cell is checked too.
+    template <typename VisitorType>
+    void ForEachInCell(const FIntPoint& Cell, VisitorType&& Visit) const
+    {
+        const int32 Bucket = CellToBucket(Cell);
+        for (int32 Slot = BucketStarts[Bucket]; Slot < BucketStarts[Bucket + 1]; ++Slot)
+        {
+            if (SortedCells[Slot] == Cell)
+            {
+                Visit(Slot);
+            }
+        }
+    }
+
+    float CellSize = 100.0f;
+
+    // NumBuckets + 1 offsets into the sorted arrays; bucket B holds slots [BucketStarts[B], BucketStarts[B + 1])
+    TArray<int32> BucketStarts;
+
+    // Per slot, grouped by bucket
+    TArray<int32> SortedIndices;
+    TArray<FVector2f> SortedLocations;
+    TArray<FIntPoint> SortedCells;
+};
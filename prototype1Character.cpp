@@ -377,18 +377,21 @@ void Aprototype1Character::FollowFlowField(float DeltaTime)
             }
         }
 
-        // Debug visualization
-        DrawDebugDirectionalArrow(
-            GetWorld(),
-            GetActorLocation(),
-            GetActorLocation() + FlowDirection * 200.0f,
-            20.0f,
-            FColor::Yellow,
-            false,
-            -1.0f,
-            0,
-            2.0f
-        );
+        // Debug visualization, shown alongside the flow field itself
+        if (AFlowFieldSystem::IsDebugDrawEnabled())
+        {
+            DrawDebugDirectionalArrow(
+                GetWorld(),
+                GetActorLocation(),
+                GetActorLocation() + FlowDirection * 200.0f,
+                20.0f,
+                FColor::Yellow,
+                false,
+                -1.0f,
+                0,
+                2.0f
+            );
+        }
     }
 }
 